@@ -0,0 +1,63 @@
+/** @file arena.cpp
+ *
+ *	@brief	class Arena implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "arena.h"
+
+// private:
+
+/// Add a block large enough for n bytes aligned to align, and allocate them from it
+void* Arena::grow(size_t n, size_t align) {
+	const size_t size = std::max({ first, blocks ? blocks->size * 2 : 0, n + align });
+	Block* b = static_cast<Block*>(std::malloc(sizeof(Block) + size));
+	if (!b)
+		throw std::bad_alloc();
+
+	b->next = blocks;
+	b->size = size;
+	blocks = b;
+	p = reinterpret_cast<char*>(b + 1);
+	lim = p + size;
+
+	return allocate(n, align);
+}
+
+// public:
+
+/// Construct an empty arena, whose first block will be block bytes
+Arena::Arena(size_t block)
+	: blocks{nullptr}, p{nullptr}, lim{nullptr}, used{0}, total{0}, first{block} {
+}
+
+/// Destructor; release every block
+Arena::~Arena() {
+	while (blocks) {
+		Block* b = blocks;
+		blocks = b->next;
+		std::free(b);
+	}
+}
+
+/// Release everything allocated, keeping the current, and largest, block for reuse
+void Arena::reset() {
+	if (!blocks)
+		return;
+
+	for (Block* b = blocks->next; b; ) {
+		Block* next = b->next;
+		std::free(b);
+		b = next;
+	}
+
+	blocks->next = nullptr;
+	p = reinterpret_cast<char*>(blocks + 1);
+	lim = p + blocks->size;
+	used = 0;
+}
@@ -0,0 +1,107 @@
+/** @file arena.h
+ *
+ *	@brief	class Arena and ArenaAllocator
+ *
+ *	Bump allocation, released all at once; per statement scratch storage, and
+ *	long lived pools.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/** A bump allocator
+ *
+ *	Allocates from a chain of blocks, each at least twice the size of the one
+ *	before it, and releases everything at once; individual allocations are
+ *	never freed. reset() keeps the largest block, so that an arena reset
+ *	after each statement soon stops calling malloc at all.
+ */
+class Arena {
+	/// A block of storage; its bytes follow
+	struct Block {
+		Block*		next;				///< The previous block
+		size_t		size;				///< Bytes following the header
+	};
+
+	Block*			blocks;				///< The current block, and those before it
+	char*			p;					///< Next free byte in the current block
+	char*			lim;				///< End of the current block
+	size_t			used;				///< Bytes allocated since reset()
+	size_t			total;				///< Bytes allocated since construction
+	size_t			first;				///< Size of the first block
+
+	void* grow(size_t n, size_t align);
+
+public:
+	static const size_t defaultBlock = 16 * 1024;	///< Default first block size
+
+	explicit Arena(size_t block = defaultBlock);
+	~Arena();
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	/// Return n bytes aligned to align, a power of two
+	void* allocate(size_t n, size_t align = alignof(std::max_align_t)) {
+		char* q = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~uintptr_t(align - 1));
+		if (size_t(lim - q) < n || q > lim)
+			return grow(n, align);
+
+		p = q + n;
+		used += n;
+		total += n;
+		return q;
+	}
+
+	/// Return a copy of s
+	std::string_view copy(std::string_view s) {
+		char* q = static_cast<char*>(allocate(s.size(), 1));
+		s.copy(q, s.size());
+		return std::string_view(q, s.size());
+	}
+
+	void reset();
+
+	/// Bytes allocated since reset()
+	size_t bytes() const				{	return used;	}
+
+	/// Bytes allocated since construction
+	size_t allocated() const			{	return total;	}
+};
+
+/// A standard allocator, for containers, allocating from an Arena
+template<typename T>
+struct ArenaAllocator {
+	typedef T value_type;
+
+	Arena*		arena;					///< The arena
+
+	/// Allocate from a
+	ArenaAllocator(Arena& a) : arena{&a} {}
+
+	/// Allocate from a's arena
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& a) : arena{a.arena} {}
+
+	/// Return storage for n T's
+	T* allocate(size_t n)				{	return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));	}
+
+	/// Released with the arena
+	void deallocate(T*, size_t)			{}
+
+	/// Do the allocators share an arena?
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& a) const	{	return arena == a.arena;	}
+
+	/// Do the allocators use different arenas?
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& a) const	{	return arena != a.arena;	}
+};
+
+#endif
@@ -0,0 +1,64 @@
+/** @file array.cpp
+ *
+ *	@brief	class Array implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <vector>
+
+#include "array.h"
+
+/// Construct an array of n uninitialized elements
+Array::Array(size_t n) : n{n}, p{nullptr} {
+	void* q = nullptr;
+	if (0 != posix_memalign(&q, align, (n ? n : 1) * sizeof(double)))
+		throw std::bad_alloc();
+
+	p = static_cast<double*>(q);
+}
+
+/// Destructor
+Array::~Array() {
+	free(p);
+}
+
+/** Load an array from a file
+ *
+ *	The file contains floating-point numbers seperated by white space and/or
+ *	commas.
+ *
+ *	@param	file	The file name
+ *
+ *	@return	The loaded array, or a null pointer if the file couldn't be opened,
+ *			or contains something other than numbers.
+ */
+ArrayPtr Array::load(const std::string& file) {
+	std::ifstream ifile(file);
+	if (!ifile.is_open())
+		return ArrayPtr();
+
+	std::vector<double> values;
+	for (;;) {
+		char ch;
+		if (!(ifile >> ch))
+			break;						// end of file
+		else if (ch == ',')
+			continue;
+
+		ifile.putback(ch);
+
+		double v;
+		if (!(ifile >> v))
+			return ArrayPtr();			// not a number
+		values.push_back(v);
+	}
+
+	ArrayPtr a = std::make_shared<Array>(values.size());
+	std::copy(values.begin(), values.end(), a->data());
+	return a;
+}
@@ -0,0 +1,58 @@
+/** @file array.h
+ *
+ *	@brief	class Array
+ *
+ *	Vector values; reference counted, cache-line aligned, arrays of doubles.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+class Array;
+
+/// Shared reference to an Array
+typedef std::shared_ptr<Array> ArrayPtr;
+
+/** A contiguous, aligned, fixed size array of doubles
+ *
+ *	Arrays are shared by the variables, and evaluation stack entries that
+ *	refer to them, and are only modified in place when they're not shared.
+ */
+class Array {
+	size_t		n;						///< Number of elements
+	double*		p;						///< The elements
+
+public:
+	static const size_t align = 64;		///< Element alignment, in bytes
+
+	explicit Array(size_t n);
+	~Array();
+
+	Array(const Array&) = delete;
+	Array& operator=(const Array&) = delete;
+
+	/// Number of elements
+	size_t size() const					{	return n;		}
+
+	/// The elements
+	double* data()						{	return p;		}
+
+	/// The elements
+	const double* data() const			{	return p;		}
+
+	/// Element i
+	double& operator[](size_t i)		{	return p[i];	}
+
+	/// Element i
+	double operator[](size_t i) const	{	return p[i];	}
+
+	static ArrayPtr load(const std::string& file);
+};
+
+#endif
@@ -0,0 +1,135 @@
+/** @file ast.h
+ *
+ *	@brief	enum Op, struct Node and class Tree
+ *
+ *	The abstract syntax tree built by the Parser for each statement. Nodes live
+ *	in a Tree, and refer to each other by index, so that a statement's tree can
+ *	be discarded in one shot once it has been compiled.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef AST_H
+#define AST_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+#include "symbol.h"
+
+/************************************************************************************************
+ *	Tree operations																				*
+ ************************************************************************************************/
+
+/// Parse tree node operations
+enum class Op : unsigned char {
+	number,								///< floating-point literal
+	integer,							///< integer literal
+	variable,							///< symbol reference
+	assign,								///< symbol = left
+	neg,								///< -left
+	add,								///< left + right
+	sub,								///< left - right
+	mul,								///< left * right
+	div,								///< left / right
+	mod,								///< left % right
+	pow,								///< left ^ right
+	lt,									///< left < right
+	le,									///< left <= right
+	gt,									///< left > right
+	ge,									///< left >= right
+	eq,									///< left == right
+	ne,									///< left != right
+	land,								///< left && right; both are evaluated
+	lor,								///< left || right; both are evaluated
+	lnot,								///< !left
+	call0,								///< builtin ()
+	call1,								///< builtin1 (left)
+	call2,								///< builtin2 (left, right)
+	callv,								///< builtinv (left)
+	call,								///< function or procedure (left), left is a list, or nil
+	arg,								///< $sym
+	setarg,								///< $sym = left
+	vector,								///< [ left ], left is a list
+	list,								///< left, and the rest of the list, right
+	range,								///< [ left : right : step ]
+	file								///< load ( str )
+};
+
+/// Index of a Node within its Tree
+typedef unsigned NodeRef;
+
+/// Reference to no Node at all
+const NodeRef nilNode = ~0u;
+
+/************************************************************************************************
+ *	Tree nodes																					*
+ ************************************************************************************************/
+
+/// A parse tree node
+struct Node {
+	Op							op;		///< Operation
+	NodeRef						left;	///< Left (or only) operand
+	NodeRef						right;	///< Right operand
+	union {
+		double					value;	///< op == number
+		int64_t					integer;	///< op == integer
+		SymbolId				sym;	///< op == variable, assign, callN or call; arg number for arg and setarg
+		NodeRef					step;	///< op == range; nilNode for the default step
+		unsigned				str;	///< op == file; index into the Tree's strings
+	};
+
+	/// Construct a literal
+	explicit Node(double v) : op{Op::number}, left{nilNode}, right{nilNode}, value{v} {}
+
+	/// Construct an integer literal
+	explicit Node(int64_t i) : op{Op::integer}, left{nilNode}, right{nilNode}, integer{i} {}
+
+	/// Construct a reference to, assignment to, or call of, the symbol s
+	Node(SymbolId s, Op o, NodeRef l = nilNode, NodeRef r = nilNode)
+		: op{o}, left{l}, right{r}, sym{s} {}
+
+	/// Construct an unary or binary operation
+	Node(Op o, NodeRef l, NodeRef r = nilNode) : op{o}, left{l}, right{r}, value{0} {}
+};
+
+/************************************************************************************************
+ *	Trees																						*
+ ************************************************************************************************/
+
+/** A statement's parse tree; a pool of nodes
+ *
+ *	The nodes' storage is reused from one tree to the next. String literals are
+ *	copied into the statement's arena, and so are only valid until it's reset.
+ */
+class Tree {
+	Arena*						arena;	///< String literal storage
+	std::vector<Node>			nodes;	///< The nodes, roots last
+	std::vector<std::string_view> strs;	///< String literals, in arena
+
+public:
+	/// Construct an empty tree, whose strings are allocated from a
+	explicit Tree(Arena& a) : arena{&a} {}
+
+	/// Add node n, returning its reference
+	NodeRef add(const Node& n)			{	nodes.push_back(n); return NodeRef(nodes.size() - 1);	}
+
+	/// Add the string literal s, returning its index
+	unsigned add(std::string_view s)	{	strs.push_back(arena->copy(s)); return unsigned(strs.size() - 1);	}
+
+	/// Return the node refered to by r
+	const Node& operator[](NodeRef r) const	{	return nodes[r];	}
+
+	/// Return string literal i
+	std::string_view str(unsigned i) const	{	return strs[i];	}
+
+	/// Discard all nodes and strings
+	void clear()						{	nodes.clear(); strs.clear();	}
+
+	/// Number of nodes
+	size_t size() const					{	return nodes.size();	}
+};
+
+#endif
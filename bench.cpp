@@ -0,0 +1,633 @@
+/**	@file	bench.cpp
+ *
+ *	@brief	calc benchmarks
+ *
+ *	The suite generates synthetic scripts; long arithmetic chains, deeply
+ *	nested expressions, many variables, builtin heavy lines and huge numeric
+ *	literals. Each is measured in a child process of its own, for tokens
+ *	scanned, statements compiled, and statements compiled and executed per
+ *	second, and peak resident set size. Results are written as JSON lines, and
+ *	optionally compared against those of a previous run.
+ *
+ *	The comparisons that follow measure evaluations per second of a statement
+ *	when it's re-lexed and re-parsed for every evaluation, versus compiling it
+ *	once and running it on the VM, or natively, floating-point literals scanned per second
+ *	by iostreams versus the TokenStream, and results written per second by
+ *	iostreams versus Output.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "driver.h"
+
+/// Seconds since some fixed point in time
+static double now() {
+	using namespace std::chrono;
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+/************************************************************************************************
+ *	Workloads																					*
+ ************************************************************************************************/
+
+/// Each workload's variables
+static const char prologue[] = "x = 1.5; y = 2.5; z = 3.5\n";
+
+/// n statements, each a chain of 64 terms and operators
+static std::string chains(unsigned n) {
+	std::mt19937_64 gen(42);
+	const char* terms[] = { "x", "y", "z", "2", "3.5", "7", "0.25" };
+	const char* ops[] = { " + ", " - ", " * ", " / " };
+	std::string s = prologue;
+
+	for (unsigned i = 0; i < n; ++i) {
+		s += "v = x";
+		for (unsigned j = 0; j < 64; ++j) {
+			s += ops[gen() % 4];
+			s += terms[gen() % 7];
+		}
+		s += '\n';
+	}
+
+	return s;
+}
+
+/// n statements, each nested 48 parentheses deep
+static std::string nesting(unsigned n) {
+	const unsigned depth = 48;
+	const char* ops[] = { " + ", " - ", " * ", " / " };
+	std::string s = prologue;
+
+	for (unsigned i = 0; i < n; ++i) {
+		s += "v = ";
+		s.append(depth, '(');
+		s += 'x';
+		for (unsigned j = 0; j < depth; ++j) {
+			s += ops[(i + j) % 4];
+			s += char('1' + j % 9);
+			s += ')';
+		}
+		s += '\n';
+	}
+
+	return s;
+}
+
+/// n statements, over as many as 10000 distinct variables
+static std::string variables(unsigned n) {
+	std::mt19937_64 gen(42);
+	const unsigned nvars = std::min(n, 10000u);
+	std::string s = prologue;
+
+	for (unsigned i = 0; i < nvars; ++i)
+		s += "var" + std::to_string(i) + " = " + std::to_string(i) + '\n';
+
+	for (unsigned i = nvars; i < n; ++i)
+		s += "var" + std::to_string(gen() % nvars) + " = var" + std::to_string(gen() % nvars)
+		  + " * 0.5 + var" + std::to_string(gen() % nvars) + " * 0.5\n";
+
+	return s;
+}
+
+/// n statements, each calling a dozen builtins
+static std::string builtins(unsigned n) {
+	std::string s = prologue;
+
+	for (unsigned i = 0; i < n; ++i)
+		s += "v = sin(x) + cos(y) * sqrt(z) - log(x) + exp(y / 10) + atan2(x, y) + abs(z)"
+			 " + int(x) + log10(z) + atan(y) - sqrt(x * y) + cos(z) * sin(y)\n";
+
+	return s;
+}
+
+/// n statements, each summing four literals of up to 64 digits
+static std::string huge(unsigned n) {
+	std::mt19937_64 gen(42);
+	std::string s = prologue;
+
+	for (unsigned i = 0; i < n; ++i) {
+		s += "v = ";
+		for (unsigned j = 0; j < 4; ++j) {
+			if (j)
+				s += " + ";
+			s += char('1' + gen() % 9);
+			for (unsigned k = gen() % 40; k > 0; --k)
+				s += char('0' + gen() % 10);
+			s += '.';
+			for (unsigned k = gen() % 24; k > 0; --k)
+				s += char('0' + gen() % 10);
+			s += 'e' + std::to_string(int(gen() % 61) - 30);
+		}
+		s += '\n';
+	}
+
+	return s;
+}
+
+/// n statements of integer arithmetic; a counter, sums, products and remainders
+static std::string integers(unsigned n) {
+	std::string s = "i = 0; t = 0\n";
+
+	for (unsigned k = 0; k < n; ++k)
+		s += "i = i + 1; t = t + i * i % 1009 - 2 ^ (i % 16) + (t > 1000000) * 7\n";
+
+	return s;
+}
+
+/// A generated script
+struct Workload {
+	const char*		name;							///< Name, as reported
+	std::string		(*generate)(unsigned n);		///< Generate n statements
+};
+
+static const Workload workloads[] = {
+	{ "chains",		chains		},
+	{ "nesting",	nesting		},
+	{ "variables",	variables	},
+	{ "builtins",	builtins	},
+	{ "literals",	huge		},
+	{ "integers",	integers	}
+};
+
+/************************************************************************************************
+ *	Measurements																				*
+ ************************************************************************************************/
+
+/// A workload's measurements
+struct Result {
+	double			tokens;				///< Tokens in the script
+	double			statements;			///< Statements in the script
+	double			tokensPerSec;		///< Tokens scanned per second
+	double			compilesPerSec;		///< Statements compiled per second
+	double			statementsPerSec;	///< Statements compiled and executed per second
+	double			peakRSS;			///< Peak resident set size, in KiB
+	double			errors;				///< Errors reported running the script
+};
+
+/// A reported measurement
+struct Metric {
+	const char*		key;				///< JSON key
+	const char*		heading;			///< Column heading
+	double Result::*value;				///< The measurement
+	bool			higher;				///< Is higher better?
+};
+
+static const Metric metrics[] = {
+	{ "tokens_per_sec",		"tokens/sec",	&Result::tokensPerSec,		true	},
+	{ "compiles_per_sec",	"compiles/sec",	&Result::compilesPerSec,	true	},
+	{ "statements_per_sec",	"stmts/sec",	&Result::statementsPerSec,	true	},
+	{ "peak_rss_kib",		"peak KiB",		&Result::peakRSS,			false	}
+};
+
+/** Measure a script; the best of three runs of each pass
+ *
+ *	@param	prog	Program name
+ *	@param	script	The script
+ *
+ *	@return	The measurements
+ */
+static Result measure(const char* prog, const std::string& script) {
+	Driver driver(prog);
+	Result r{};
+
+	for (unsigned rep = 0; rep < 3; ++rep) {
+		unsigned long tokens = 0;
+		double start = now();
+		driver.set_input(script.data(), script.size());
+		while (driver.ts.get().kind != Kind::end)
+			++tokens;
+		r.tokens = tokens;
+		r.tokensPerSec = std::max(r.tokensPerSec, tokens / (now() - start));
+
+		unsigned long stmts = 0;
+		Code code;
+		start = now();
+		driver.set_input(script.data(), script.size());
+		while (driver.compile(code))
+			++stmts;
+		r.statements = stmts;
+		r.compilesPerSec = std::max(r.compilesPerSec, stmts / (now() - start));
+
+		start = now();
+		driver.set_input(script.data(), script.size());
+		driver.parse();
+		r.statementsPerSec = std::max(r.statementsPerSec, stmts / (now() - start));
+	}
+
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	r.peakRSS = ru.ru_maxrss;			// KiB on Linux
+	r.errors = driver.nErrors;
+	return r;
+}
+
+/** Generate and measure a workload in a child process, isolating its peak RSS
+ *
+ *	@param	prog	Program name
+ *	@param	w		The workload
+ *	@param	n		Number of statements
+ *	@param	r		The measurements
+ *
+ *	@return	false if the child failed
+ */
+static bool isolated(const char* prog, const Workload& w, unsigned n, Result& r) {
+	int fds[2];
+	if (0 != pipe(fds))
+		return false;
+
+	const pid_t pid = fork();
+	if (0 == pid) {
+		close(fds[0]);
+		const Result m = measure(prog, w.generate(n));
+		_exit(sizeof m == write(fds[1], &m, sizeof m) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	const bool ok = pid > 0 && sizeof r == read(fds[0], &r, sizeof r);
+	close(fds[0]);
+	if (pid > 0)
+		waitpid(pid, nullptr, 0);
+
+	return ok;
+}
+
+/************************************************************************************************
+ *	Results files																				*
+ ************************************************************************************************/
+
+/// A set of results, by workload name
+typedef std::map<std::string, Result> Results;
+
+/// Write results to file, as JSON lines; return false on failure
+static bool save(const std::string& file, const Results& results) {
+	std::ofstream os(file);
+
+	os.precision(17);
+	for (const auto& r : results) {
+		os << "{\"workload\": \"" << r.first << "\", \"statements\": " << r.second.statements
+		   << ", \"tokens\": " << r.second.tokens;
+		for (const Metric& m : metrics)
+			os << ", \"" << m.key << "\": " << r.second.*m.value;
+		os << "}\n";
+	}
+
+	return bool(os);
+}
+
+/// Return the number following "key": in line, or NaN
+static double field(const std::string& line, const std::string& key) {
+	const std::string::size_type n = line.find('"' + key + "\":");
+	if (std::string::npos == n)
+		return std::numeric_limits<double>::quiet_NaN();
+
+	return std::strtod(line.c_str() + n + key.size() + 3, nullptr);
+}
+
+/// Read results written by save(); missing measurements are NaN
+static Results load(const std::string& file) {
+	std::ifstream is(file);
+	const std::string tag = "\"workload\": \"";
+	Results results;
+
+	for (std::string line; std::getline(is, line); ) {
+		const std::string::size_type first = line.find(tag);
+		if (std::string::npos == first)
+			continue;
+
+		const std::string::size_type last = line.find('"', first + tag.size());
+		Result& r = results[line.substr(first + tag.size(), last - first - tag.size())];
+		r.statements = field(line, "statements");
+		r.tokens = field(line, "tokens");
+		for (const Metric& m : metrics)
+			r.*m.value = field(line, m.key);
+	}
+
+	return results;
+}
+
+/************************************************************************************************
+ *	Comparisons																					*
+ ************************************************************************************************/
+
+/** Evaluate stmt n times, re-parsing it each time
+ *
+ *	@param	driver	The parser driver
+ *	@param	stmt	The statement to evaluate
+ *	@param	n		Number of evaluations
+ *
+ *	@return evaluations per second
+ */
+static double reparse(Driver& driver, const std::string& stmt, unsigned n) {
+	const double start = now();
+	for (unsigned i = 0; i < n; ++i) {
+		driver.set_input(stmt.data(), stmt.size());
+		driver.parse();
+	}
+
+	return n / (now() - start);
+}
+
+/** Compile stmt once, and then execute it n times
+ *
+ *	@param	driver	The parser driver
+ *	@param	stmt	The statement to evaluate
+ *	@param	n		Number of evaluations
+ *	@param	jit		Run it natively?
+ *
+ *	@return evaluations per second
+ */
+static double compiled(Driver& driver, const std::string& stmt, unsigned n, bool jit) {
+	Code code;
+	driver.jit = jit;
+
+	const double start = now();
+	driver.set_input(stmt.data(), stmt.size());
+	driver.compile(code);
+	for (unsigned i = 0; i < n; ++i)
+		driver.vm(code);
+
+	return n / (now() - start);
+}
+
+/** Run script, a loop of n iterations, or n unrolled statements
+ *
+ *	@param	driver	The parser driver
+ *	@param	script	The script
+ *	@param	n		Number of iterations
+ *
+ *	@return	iterations per second
+ */
+static double iterations(Driver& driver, const std::string& script, unsigned n) {
+	const double start = now();
+	driver.set_input(script.data(), script.size());
+	driver.parse();
+
+	return n / (now() - start);
+}
+
+/// n unrolled iterations of the body of loop()
+static std::string unrolled(unsigned n) {
+	std::string s = "i = 0; s = 0\n";
+	for (unsigned i = 0; i < n; ++i)
+		s += "s = s + i * i; i = i + 1\n";
+	return s;
+}
+
+/// A loop of n iterations; squaring i inline, or by calling sq()
+static std::string loop(unsigned n, bool call) {
+	return "func sq() return $1 * $1\ni = 0; s = 0\nwhile (i < " + std::to_string(n) + ") { s = s + "
+		+ (call ? "sq(i)" : "i * i") + "; i = i + 1 }\n";
+}
+
+/** Generate n random floating-point literals, one per line
+ *
+ *	@param	n	Number of literals
+ *
+ *	@return	The literals
+ */
+static std::string literals(unsigned n) {
+	std::mt19937_64 gen(42);
+	std::uniform_real_distribution<double> mantissa(0, 1000);
+	std::uniform_int_distribution<int> exponent(-300, 300);
+	std::ostringstream os;
+
+	os.precision(17);
+	for (unsigned i = 0; i < n; ++i) {
+		switch(i % 4) {
+		case 0:		os << unsigned(mantissa(gen) * 1000);					break;
+		case 1:		os << mantissa(gen);									break;
+		case 2:		os << mantissa(gen) << 'e' << exponent(gen);			break;
+		default:	os << std::fixed << mantissa(gen) << std::defaultfloat;	break;
+		}
+		os << '\n';
+	}
+
+	return os.str();
+}
+
+/// Scan text's literals with iostreams; return literals per second
+static double streamed(const std::string& text) {
+	std::istringstream is{text};
+	unsigned n = 0;
+	double v;
+
+	const double start = now();
+	while (is >> v)
+		++n;
+
+	return n / (now() - start);
+}
+
+/// Scan text's literals with the driver's TokenStream; return literals per second
+static double scanned(Driver& driver, const std::string& text) {
+	unsigned n = 0;
+
+	const double start = now();
+	driver.set_input(text.data(), text.size());
+	for (Kind k; (k = driver.ts.get().kind) != Kind::end; )
+		if (k == Kind::number)
+			++n;
+
+	return n / (now() - start);
+}
+
+/// Write n results to /dev/null with iostreams; return results per second
+static double ostreamed(unsigned n) {
+	std::ofstream os("/dev/null");
+
+	const double start = now();
+	for (unsigned i = 0; i < n; ++i)
+		os << '\t' << i / 7.0 << '\n';
+	os.flush();
+
+	return n / (now() - start);
+}
+
+/// Generate n uniforms in bulk, with uniform(v); return uniforms per second
+static double bulk(Driver& driver, unsigned n) {
+	const std::string stmt = "u = uniform(v)";
+	const std::string init = "v = [1:" + std::to_string(n) + "] * 0 + 1";
+	driver.set_input(init.data(), init.size());
+	driver.parse();
+
+	Code code;
+	driver.set_input(stmt.data(), stmt.size());
+	driver.compile(code);
+
+	const double start = now();
+	driver.vm(code);
+	return n / (now() - start);
+}
+
+/// Write n results to /dev/null with Output; return results per second
+static double output(unsigned n, int precision) {
+	const int fd = open("/dev/null", O_WRONLY);
+	double rate = 0;
+	{
+		Output out(fd);
+		out.precision(precision);
+
+		const double start = now();
+		for (unsigned i = 0; i < n; ++i)
+			out << '\t' << i / 7.0 << '\n';
+		out.flush();
+		rate = n / (now() - start);
+	}
+
+	close(fd);
+	return rate;
+}
+
+/************************************************************************************************
+ *	main																						*
+ ************************************************************************************************/
+
+/** Run the suite, and the comparisons
+ *
+ *	calcbench [-n statements] [-e evaluations] [-o results] [-b baseline] [-t percent]
+ *
+ *	-e 0 skips the comparisons. With a baseline, changes of more than percent
+ *	(default 10) for the worse are flagged with a '*', and counted.
+ *
+ *	@return	The number of regressions, plus any errors
+ */
+int main(int argc, char* argv[]) {
+	unsigned nstmts = 20000, n = 1000000;
+	std::string resultsFile = "bench.json", baselineFile;
+	double threshold = 10;
+
+	for (int argn = 1; argn < argc; ++argn) {
+		const std::string arg = argv[argn];
+		const char* value = argn + 1 < argc ? argv[++argn] : nullptr;
+
+		if (value && "-n" == arg)		nstmts = std::atoi(value);
+		else if (value && "-e" == arg)	n = std::atoi(value);
+		else if (value && "-o" == arg)	resultsFile = value;
+		else if (value && "-b" == arg)	baselineFile = value;
+		else if (value && "-t" == arg)	threshold = std::atof(value);
+		else {
+			std::cerr << "Usage: " << argv[0]
+					  << " [-n statements] [-e evaluations] [-o results] [-b baseline] [-t percent]\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	const Results baseline = baselineFile.empty() ? Results() : load(baselineFile);
+	Results results;
+	int status = 0;
+
+	std::cout << std::left << std::setw(12) << "workload";
+	for (const Metric& m : metrics)
+		std::cout << std::right << std::setw(14) << m.heading;
+	std::cout << '\n' << std::setprecision(4);
+
+	for (const Workload& w : workloads) {
+		Result r;
+		if (!isolated(argv[0], w, nstmts, r)) {
+			std::cerr << argv[0] << ": workload " << w.name << " failed\n";
+			++status;
+			continue;
+		}
+
+		results[w.name] = r;
+		std::cout << std::left << std::setw(12) << w.name;
+		for (const Metric& m : metrics)
+			std::cout << std::right << std::setw(14) << r.*m.value;
+		std::cout << '\n';
+
+		if (r.errors) {
+			std::cerr << argv[0] << ": workload " << w.name << " reported " << r.errors << " errors\n";
+			++status;
+		}
+
+		const auto b = baseline.find(w.name);
+		if (b == baseline.end())
+			continue;
+
+		std::cout << std::left << std::setw(12) << "  vs base";
+		for (const Metric& m : metrics) {
+			const double change = (r.*m.value / b->second.*m.value - 1) * 100;
+			const bool worse = std::isfinite(change) && (m.higher ? -change : change) > threshold;
+			std::ostringstream os;
+			os << std::showpos << std::fixed << std::setprecision(1) << change << '%' << (worse ? '*' : ' ');
+			std::cout << std::right << std::setw(14) << os.str();
+			status += worse;
+		}
+		std::cout << '\n';
+	}
+
+	if (!save(resultsFile, results)) {
+		std::cerr << argv[0] << ": error writing '" << resultsFile << "'\n";
+		++status;
+	}
+
+	if (0 == n)
+		return status;
+
+	const char* stmts[] = {
+		"y = x*x + 2*x - 1",
+		"y = (x + 1) * (x - 1) / (x * x + 3) ^ 2",
+		"y = sqrt(x) + log(x) * sin(x) - atan2(x, 2) * deg"
+	};
+
+	Driver driver(argv[0]);
+	const std::string init = "x = 1.5";
+	driver.set_input(init.data(), init.size());
+	driver.parse();
+
+	std::cout << "\nevaluations/sec   re-parsed    compiled         jit  statement\n";
+	for (const std::string stmt : stmts) {
+		const double before = reparse(driver, stmt, n);
+		const double after = compiled(driver, stmt, n, false);
+		const double native = compiled(driver, stmt, n, true);
+
+		std::cout << "                 " << before << "  " << after << "  " << native << "  " << stmt << '\n';
+	}
+
+	const std::string expensive = "y = pow(x, 2.5) + log(x) + exp(x) + atan2(x, 2)";
+	const double plain = compiled(driver, expensive, n, false);
+	driver.memoize = true;
+	const double memoized = compiled(driver, expensive, n, false);
+	driver.memoize = false;
+	std::cout << "\nevaluations/sec    compiled    memoized        hits      misses  statement\n";
+	std::cout << "                 " << plain << "  " << memoized << "  " << std::setw(10) << driver.memo.hits
+			  << "  " << std::setw(10) << driver.memo.misses << "  " << expensive << '\n';
+
+	const std::string text = literals(n);
+	const double before = streamed(text);
+	const double after = scanned(driver, text);
+	std::cout << "\nliterals/sec      iostream    scanned\n";
+	std::cout << "                 " << before << "  " << after << '\n';
+
+	std::cout << "\nresults/sec       iostream      output    shortest\n";
+	std::cout << "                 " << ostreamed(n) << "  " << output(n, Output::defaultPrecision)
+			  << "  " << output(n, 0) << '\n';
+
+	driver.jit = false;
+	std::cout << "\niterations/sec    unrolled        loop  with calls\n";
+	std::cout << "                 " << iterations(driver, unrolled(n), n) << "  " << iterations(driver, loop(n, false), n)
+			  << "  " << iterations(driver, loop(n, true), n) << '\n';
+
+	std::cout << "\nuniforms/sec        rand()  uniform(v)\n";
+	std::cout << "                 " << compiled(driver, "u = rand()", n, false) << "  " << bulk(driver, n) << '\n';
+
+	return status + driver.nErrors;
+}
@@ -0,0 +1,574 @@
+/** @file cache.cpp
+ *
+ *	@brief	Script and ScriptCache implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "driver.h"
+#include "source.h"
+
+/************************************************************************************************
+ *	Serialization																				*
+ ************************************************************************************************/
+
+namespace {
+
+const char magic[4] = { 'c', 'a', 'l', 'c' };	///< Cache files begin with this
+
+/// Appends a Script's parts to a string, in host byte order
+struct Writer {
+	std::string		s;					///< The bytes written
+
+	/// Write x's bytes
+	template<typename T>
+	void put(T x)						{	s.append(reinterpret_cast<const char*>(&x), sizeof x);	}
+
+	/// Write the length of t, and then t
+	void put(std::string_view t)		{	put(uint32_t(t.size())); s.append(t);	}
+
+	void put(const Code& code);
+};
+
+/// Write code's instructions, constants and strings
+void Writer::put(const Code& code) {
+	put(uint32_t(code.code.size()));
+	for (const Instr& in : code.code) {
+		put(uint8_t(in.op));
+		put(uint16_t(in.count));
+		put(uint32_t(in.arg));
+	}
+
+	put(uint32_t(code.consts.size()));
+	for (double d : code.consts)
+		put(d);
+
+	put(uint32_t(code.ints.size()));
+	for (int64_t i : code.ints)
+		put(i);
+
+	put(uint32_t(code.strs.size()));
+	for (const std::string& t : code.strs)
+		put(std::string_view(t));
+
+	put(uint32_t(code.depth));
+	put(uint32_t(code.temps));
+}
+
+/// Reads a Script's parts from a buffer, failing, rather than reading past its end
+struct Reader {
+	const char*		p;					///< Next byte to read
+	const char*		lim;				///< End of the buffer
+	bool			ok;					///< Has everything fit?
+
+	/// Read from [first, last)
+	Reader(const char* first, const char* last) : p{first}, lim{last}, ok{true} {}
+
+	/// Read a T, or 0 if there isn't room for one
+	template<typename T>
+	T get() {
+		T x{};
+		if (size_t(lim - p) < sizeof x)
+			ok = false;
+		else {
+			std::memcpy(&x, p, sizeof x);
+			p += sizeof x;
+		}
+		return x;
+	}
+
+	/// Read a length, and a string that long
+	std::string str() {
+		const uint32_t n = get<uint32_t>();
+		if (!ok || size_t(lim - p) < n) {
+			ok = false;
+			return std::string();
+		}
+		p += n;
+		return std::string(p - n, n);
+	}
+
+	/// Read a count, no more than could possibly follow, of items at least size bytes
+	uint32_t count(size_t size) {
+		const uint32_t n = get<uint32_t>();
+		if (size_t(lim - p) / size < n)
+			ok = false;
+		return ok ? n : 0;
+	}
+
+	bool get(Code& code, size_t symbols);
+};
+
+/** Read code, referring to no more than symbols symbols
+ *
+ *	Operands are checked against the constants, strings, instructions and
+ *	symbols they index, so that a damaged file can't be run; Script::bind()
+ *	checks the rest, the symbols' kinds, and the stack, once they're known.
+ */
+bool Reader::get(Code& code, size_t symbols) {
+	code.code.assign(count(7), Instr(OpCode::halt));
+	for (Instr& in : code.code) {
+		const uint8_t op = get<uint8_t>();
+		in.count = get<uint16_t>();
+		in.arg = get<uint32_t>();
+		ok = ok && op <= uint8_t(OpCode::halt);
+		in.op = OpCode(op);
+	}
+
+	code.consts.resize(count(sizeof(double)));
+	for (double& d : code.consts)
+		d = get<double>();
+
+	code.ints.resize(count(sizeof(int64_t)));
+	for (int64_t& i : code.ints)
+		i = get<int64_t>();
+
+	code.strs.resize(count(sizeof(uint32_t)));
+	for (std::string& t : code.strs)
+		t = str();
+
+	code.depth = get<uint32_t>();
+	code.temps = get<uint32_t>();
+	ok = ok && code.depth <= code.code.size() && code.temps <= code.code.size();
+
+	for (const Instr& in : code.code) {
+		switch(in.op) {
+		case OpCode::push:		ok = ok && in.arg < code.consts.size();	break;
+		case OpCode::pushi:		ok = ok && in.arg < code.ints.size();	break;
+		case OpCode::loadp:
+		case OpCode::storep:	ok = false;								break;	// host variables
+		case OpCode::file:		ok = ok && in.arg < code.strs.size();	break;
+		case OpCode::jump:
+		case OpCode::jz:		ok = ok && in.arg < code.code.size();	break;
+		case OpCode::arg:
+		case OpCode::setarg:	ok = ok && in.arg > 0;					break;	// $1...
+		case OpCode::save:
+		case OpCode::restore:	ok = ok && in.arg < code.temps;			break;
+
+		case OpCode::load:
+		case OpCode::store:
+		case OpCode::call0:
+		case OpCode::call1:
+		case OpCode::call2:
+		case OpCode::callv:
+		case OpCode::call:
+		case OpCode::print:		ok = ok && in.arg < symbols;			break;
+
+		default:				break;
+		}
+	}
+
+	return ok;
+}
+
+/// Does instruction in's operand name a symbol?
+bool symbolic(const Instr& in) {
+	switch(in.op) {
+	case OpCode::load:
+	case OpCode::store:
+	case OpCode::call0:
+	case OpCode::call1:
+	case OpCode::call2:
+	case OpCode::callv:
+	case OpCode::call:
+	case OpCode::print:		return true;
+	default:				return false;
+	}
+}
+
+/** Does code keep to the stack its depth allows?
+ *
+ *	Every path through code is followed; no instruction may pop more than has
+ *	been pushed, push beyond code.depth, or run off the end of the code, and
+ *	each instruction must be reached with the same depth by every path.
+ */
+bool balanced(const Code& code) {
+	const size_t n = code.code.size();
+	std::vector<int> depth(n, -1);		// By instruction; stack depth before it, if reached
+	std::vector<size_t> work;			// Reached, but not yet followed
+
+	auto reach = [&](size_t i, int d) {
+		if (i >= n)
+			return false;
+		if (depth[i] < 0) {
+			depth[i] = d;
+			work.push_back(i);
+		}
+		return depth[i] == d;
+	};
+
+	if (n && !reach(0, 0))
+		return false;
+
+	while (!work.empty()) {
+		const size_t i = work.back();
+		work.pop_back();
+
+		const Instr& in = code.code[i];
+		unsigned pops = 0, pushes = 0;
+		switch(in.op) {
+		case OpCode::push:
+		case OpCode::pushi:
+		case OpCode::load:
+		case OpCode::loadp:
+		case OpCode::call0:
+		case OpCode::arg:
+		case OpCode::file:
+		case OpCode::restore:	pushes = 1;						break;
+
+		case OpCode::store:
+		case OpCode::storep:
+		case OpCode::neg:
+		case OpCode::lnot:
+		case OpCode::call1:
+		case OpCode::callv:
+		case OpCode::setarg:
+		case OpCode::save:		pops = pushes = 1;				break;
+
+		case OpCode::call:		pops = in.count; pushes = 1;	break;
+		case OpCode::vector:	pops = in.arg; pushes = 1;		break;
+		case OpCode::range:		pops = 3; pushes = 1;			break;
+		case OpCode::ret:		pops = in.arg ? 1 : 0;			break;
+
+		case OpCode::print:
+		case OpCode::jz:
+		case OpCode::pop:		pops = 1;						break;
+
+		case OpCode::jump:
+		case OpCode::halt:										break;
+
+		default:				pops = 2; pushes = 1;			break;	// binary operators and call2
+		}
+
+		if (unsigned(depth[i]) < pops)
+			return false;
+		const int d = depth[i] - int(pops) + int(pushes);
+		if (unsigned(d) > code.depth)
+			return false;
+
+		switch(in.op) {
+		case OpCode::halt:
+		case OpCode::ret:		break;
+		case OpCode::jump:		if (!reach(in.arg, d)) return false;	break;
+		case OpCode::jz:		if (!reach(in.arg, d)) return false;	// fall through
+		default:				if (!reach(i + 1, d)) return false;		break;
+		}
+	}
+
+	return true;
+}
+
+/// Are symbols of kinds a and b scanned, and parsed, alike?
+bool alike(Kind a, Kind b) {
+	auto variable = [](Kind k) { return k == Kind::undefined || k == Kind::name; };
+	return a == b || (variable(a) && variable(b));
+}
+
+} // namespace
+
+/************************************************************************************************
+ *	Script																						*
+ ************************************************************************************************/
+
+/// Begin recording the script about to be parsed by driver
+void Script::begin(const Driver& driver) {
+	*this = Script();
+	base = driver.lineNum;
+	for (SymbolId id = 0; id < driver.table.size(); ++id)
+		kinds.push_back(driver.table[id].kind);
+}
+
+/// Record the statement the driver's just compiled into code, or the end of input if code's empty
+void Script::record(const Driver& driver, const Code& code) {
+	Statement& s = statements.back();
+	s.line = driver.stmtLine - base;
+	s.column = driver.stmtColumn;
+	for (SymbolId sym : driver.parser.definitions())
+		s.definitions.push_back({ sym, driver.table[sym].kind, driver.parser.body(sym) });
+	s.code = code;
+}
+
+/// End recording; add the symbols' names, and those that were added while compiling
+void Script::end(const Driver& driver) {
+	lines = driver.lineNum - base;
+	for (SymbolId id = 0; id < driver.table.size(); ++id)
+		names.emplace_back(driver.table.name(id));
+	kinds.resize(names.size(), Kind::undefined);
+}
+
+/** Bind a loaded script to the driver's symbols
+ *
+ *	The script's code is checked against the symbols it would run with; each
+ *	builtin call must name a builtin of that many arguments, each function
+ *	call a function or procedure, defined by now, each definition replace
+ *	one of the same kind, if any, each print a variable, only bodies may
+ *	return, and the stack must be used as the code says it is.
+ *
+ *	@return	false, without changing anything, if any of the script's symbols
+ *			have changed kind since it was compiled, or its code doesn't check
+ */
+bool Script::bind(Driver& driver) {
+	SymbolTable& table = driver.table;
+	std::vector<Kind> now(names.size());	// By script SymbolId; kind in the driver's table
+	for (size_t i = 0; i < names.size(); ++i) {
+		const SymbolId id = table.find(names[i]);
+		now[i] = noSymbol == id ? Kind::undefined : table[id].kind;
+		if (!alike(kinds[i], now[i]))
+			return false;
+	}
+
+	std::vector<bool> defined(names.size());	// By the statements so far?
+	auto valid = [&now, &defined](const Code& code, bool body) {
+		for (const Instr& in : code.code) {
+			const Kind k = symbolic(in) ? now[in.arg] : Kind::none;
+			switch(in.op) {
+			case OpCode::ret:	if (!body) return false;				break;
+			case OpCode::call0:	if (k != Kind::builtin) return false;	break;
+			case OpCode::call1:	if (k != Kind::builtin1) return false;	break;
+			case OpCode::call2:	if (k != Kind::builtin2) return false;	break;
+			case OpCode::callv:	if (k != Kind::builtinv) return false;	break;
+			case OpCode::call:
+				if (!defined[in.arg] && k != Kind::function && k != Kind::procedure)
+					return false;
+				break;
+			case OpCode::print:
+				if (defined[in.arg] || (k != Kind::name && k != Kind::undefined))
+					return false;
+				break;
+			default:			break;
+			}
+		}
+		return balanced(code);
+	};
+
+	for (const Statement& s : statements) {
+		for (const Definition& d : s.definitions) {
+			const Kind k = now[d.sym];
+			if (k != Kind::undefined && k != Kind::name && k != d.kind)
+				return false;
+			defined[d.sym] = true;
+		}
+
+		for (const Definition& d : s.definitions)
+			if (!valid(d.body, true))
+				return false;
+		if (!valid(s.code, false))
+			return false;
+	}
+
+	std::vector<SymbolId> ids;
+	for (const std::string& name : names)
+		ids.push_back(table.intern(name));
+
+	auto rebind = [&ids](Code& code) {
+		for (Instr& in : code.code)
+			if (symbolic(in))
+				in.arg = ids[in.arg];
+	};
+
+	for (Statement& s : statements) {
+		rebind(s.code);
+		for (Definition& d : s.definitions) {
+			d.sym = ids[d.sym];
+			rebind(d.body);
+		}
+	}
+
+	return true;
+}
+
+/************************************************************************************************
+ *	ScriptCache																					*
+ ************************************************************************************************/
+
+// private:
+
+/// Return the name of the file for the script whose text hashes to hash
+std::string ScriptCache::path(uint64_t hash) const {
+	char name[32];
+	std::snprintf(name, sizeof name, "/%016llx.calcc", (unsigned long long)hash);
+	return dir + name;
+}
+
+/// Load script from file, if it's there, intact, and for text of length bytes that hashes to hash
+bool ScriptCache::load(const std::string& file, uint64_t hash, uint64_t length, Script& script) const {
+	const int fd = ::open(file.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	MappedSource src(fd);
+	::close(fd);
+	if (!src.mapped())
+		return false;
+
+	Reader r(src.begin(), src.end());
+	if (size_t(src.end() - src.begin()) < sizeof magic || 0 != std::memcmp(src.begin(), magic, sizeof magic))
+		return false;
+	r.p += sizeof magic;
+
+	if (r.get<uint32_t>() != version || r.get<uint64_t>() != length || r.get<uint64_t>() != hash)
+		return false;
+	script.lines = r.get<uint32_t>();
+
+	script.names.resize(r.count(sizeof(uint32_t) + 1));
+	script.kinds.resize(script.names.size());
+	for (size_t i = 0; i < script.names.size(); ++i) {
+		script.names[i] = r.str();
+		script.kinds[i] = Kind(r.get<uint8_t>());
+	}
+
+	const size_t symbols = script.names.size();
+	script.statements.resize(r.count(5 * sizeof(uint32_t)));
+	for (Script::Statement& s : script.statements) {
+		s.line = r.get<uint32_t>();
+		s.column = r.get<uint32_t>();
+
+		s.diagnostics.resize(r.count(1 + 3 * sizeof(uint32_t)));
+		for (Diagnostic& d : s.diagnostics) {
+			const uint8_t code = r.get<uint8_t>();
+			d.code = Diagnostic::Code(code);
+			d.line = r.get<uint32_t>();
+			d.column = r.get<uint32_t>();
+			d.message = r.str();
+			r.ok = r.ok && code >= uint8_t(Diagnostic::Code::lexical) && code <= uint8_t(Diagnostic::Code::runtime);
+		}
+
+		s.definitions.resize(r.count(2 * sizeof(uint32_t) + 1));
+		for (Script::Definition& d : s.definitions) {
+			d.sym = r.get<uint32_t>();
+			d.kind = Kind(r.get<uint8_t>());
+			r.ok = r.ok && d.sym < symbols && (d.kind == Kind::function || d.kind == Kind::procedure);
+			if (!r.get(d.body, symbols))
+				return false;
+		}
+
+		if (!r.get(s.code, symbols))
+			return false;
+	}
+
+	return r.ok && r.p == r.lim;
+}
+
+/// Save script, compiled from text of length bytes that hashes to hash, as file; quietly, if at all
+void ScriptCache::save(const std::string& file, uint64_t hash, uint64_t length, const Script& script) const {
+	Writer w;
+	w.s.append(magic, sizeof magic);
+	w.put(version);
+	w.put(length);
+	w.put(hash);
+	w.put(uint32_t(script.lines));
+
+	w.put(uint32_t(script.names.size()));
+	for (size_t i = 0; i < script.names.size(); ++i) {
+		w.put(std::string_view(script.names[i]));
+		w.put(uint8_t(script.kinds[i]));
+	}
+
+	w.put(uint32_t(script.statements.size()));
+	for (const Script::Statement& s : script.statements) {
+		w.put(uint32_t(s.line));
+		w.put(uint32_t(s.column));
+
+		w.put(uint32_t(s.diagnostics.size()));
+		for (const Diagnostic& d : s.diagnostics) {
+			w.put(uint8_t(d.code));
+			w.put(uint32_t(d.line));
+			w.put(uint32_t(d.column));
+			w.put(std::string_view(d.message));
+		}
+
+		w.put(uint32_t(s.definitions.size()));
+		for (const Script::Definition& d : s.definitions) {
+			w.put(uint32_t(d.sym));
+			w.put(uint8_t(d.kind));
+			w.put(d.body);
+		}
+
+		w.put(s.code);
+	}
+
+	std::string temp = dir + "/.calcc.XXXXXX";	// written aside, then renamed into place
+	int fd = mkstemp(&temp[0]);
+	if (fd < 0 && ENOENT == errno && 0 == ::mkdir(dir.c_str(), 0777)) {
+		temp = dir + "/.calcc.XXXXXX";	// the cache's first script
+		fd = mkstemp(&temp[0]);
+	}
+	if (fd < 0)
+		return;
+
+	const char* p = w.s.data();
+	size_t n = w.s.size();
+	while (n) {
+		const ssize_t written = ::write(fd, p, n);
+		if (written <= 0)
+			break;
+		p += written;
+		n -= written;
+	}
+
+	if (0 != ::close(fd) || n || 0 != std::rename(temp.c_str(), file.c_str()))
+		std::remove(temp.c_str());
+}
+
+// public:
+
+/// Return the hash of the n bytes at s
+uint64_t ScriptCache::hash(const char* s, size_t n) {
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+	for (; n >= 8; s += 8, n -= 8) {
+		uint64_t w;
+		std::memcpy(&w, s, 8);
+		h = (h ^ w) * 0xff51afd7ed558ccdULL;
+		h ^= h >> 32;
+	}
+
+	uint64_t w = 0;
+	std::memcpy(&w, s, n);
+	h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+	return h ^ (h >> 33);
+}
+
+/** Parse, compile and execute src, which the driver then owns
+ *
+ *	If src is in the cache, and still compiles as it did, its compiled
+ *	statements are run. Otherwise it's parsed as usual, and saved. Input that
+ *	isn't entirely in memory, such as a pipe, is always parsed.
+ *
+ *	@return The number of errors encountered.
+ */
+unsigned ScriptCache::parse(Driver& driver, Source* src) const {
+	if (!src->complete()) {
+		driver.set_input(src);
+		return driver.parse();
+	}
+
+	const uint64_t length = uint64_t(src->end() - src->begin());
+	const uint64_t h = hash(src->begin(), length);
+	const std::string file = path(h);
+
+	Script script;
+	if (load(file, h, length, script) && script.bind(driver)) {
+		delete src;
+		return driver.run(script);
+	}
+
+	script.begin(driver);
+	driver.script = &script;
+	driver.set_input(src);
+	const unsigned nerrors = driver.parse();
+	driver.script = nullptr;
+
+	script.end(driver);
+	save(file, h, length, script);
+	return nerrors;
+}
@@ -0,0 +1,90 @@
+/** @file cache.h
+ *
+ *	@brief	struct Script and class ScriptCache
+ *
+ *	Compiled scripts, saved on disk, and keyed by the hash of their text, so
+ *	that they may be run again without being scanned, or parsed.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "code.h"
+#include "diagnostic.h"
+#include "symbol.h"
+#include "token.h"
+
+class Driver;
+
+/** A script's compiled statements
+ *
+ *	Compiling a script depends only on its text, and on the kinds of the
+ *	symbols it names; builtins, functions and procedures are scanned, and
+ *	parsed, differently from variables. So a script is recorded as it's parsed;
+ *	each compiled statement, with the errors reported, and the functions and
+ *	procedures defined, while compiling it, and the kind of every symbol
+ *	when compilation began. It may then be run again, as long as none of those
+ *	kinds have changed. Lines are relative to the line the script began on.
+ */
+struct Script {
+	/// A function, or procedure, definition
+	struct Definition {
+		SymbolId	sym;				///< The function or procedure
+		Kind		kind;				///< Kind::function or Kind::procedure
+		Code		body;				///< Its body
+	};
+
+	/// A statement, with what happened while compiling it
+	struct Statement {
+		unsigned	line = 0;			///< Line the statement began on
+		unsigned	column = 0;			///< Column the statement began at
+		std::vector<Diagnostic>	diagnostics;	///< Errors reported compiling it
+		std::vector<Definition>	definitions;	///< Made compiling it
+		Code		code;				///< The statement; empty at the end of input
+	};
+
+	std::vector<std::string>	names;	///< Symbol names, by SymbolId when compiled
+	std::vector<Kind>		kinds;		///< Symbol kinds when compilation began, by SymbolId
+	std::vector<Statement>	statements;	///< The compiled statements, in order
+	unsigned				lines = 0;	///< Lines in the script
+	unsigned				base = 0;	///< Line the script began on, while recording
+
+	void begin(const Driver& driver);
+	void record(const Driver& driver, const Code& code);
+	void end(const Driver& driver);
+	bool bind(Driver& driver);
+};
+
+/** A directory of compiled scripts
+ *
+ *	Each script is saved in a file named for the hash of its text, with the
+ *	format's version, and the text's length and hash, in its header. A script
+ *	is run from the cache only if all of these match, and its symbols' kinds
+ *	are unchanged; otherwise it's parsed, and saved again. Files are replaced
+ *	atomically, so concurrent calc's may share a cache.
+ */
+class ScriptCache {
+	std::string		dir;				///< The cache directory
+
+	std::string path(uint64_t hash) const;
+	bool load(const std::string& file, uint64_t hash, uint64_t length, Script& script) const;
+	void save(const std::string& file, uint64_t hash, uint64_t length, const Script& script) const;
+
+public:
+	static const uint32_t version = 3;	///< Format version
+
+	/// Cache compiled scripts in directory d
+	explicit ScriptCache(const std::string& d) : dir{d} {}
+
+	static uint64_t hash(const char* s, size_t n);
+
+	unsigned parse(Driver& driver, Source* src) const;
+};
+
+#endif
@@ -13,13 +13,25 @@
  *	Copyright (c) 2016 Randy Merkel. All rights reserved.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cctype>
-#include <fstream>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "cache.h"
+#include "csv.h"
 #include "driver.h"
+#include "server.h"
 
 /** Write a help message to standard error
  *
@@ -31,18 +43,54 @@ static void help(std::string progName) {
 	std::cerr << "\t-e expr  \tEvaluate expr"							<< std::endl;
 	std::cerr << "\t-f file  \tRead and evaluate the conents of file"	<< std::endl;
 	std::cerr << "\t-h,-?    \tDisplay this message and exit"			<< std::endl;
+	std::cerr << "\t-J       \tCompile frequently run statements to machine code"	<< std::endl;
+	std::cerr << "\t-j jobs  \tEvaluate consecutive -f files concurrently, each"	<< std::endl;
+	std::cerr << "\t         \twith its own variables; 0 is one job per CPU"	<< std::endl;
+	std::cerr << "\t-m       \tCache the results of calls to pure builtins"	<< std::endl;
+	std::cerr << "\t-p digits\tPrint results to digits significant digits,"	<< std::endl;
+	std::cerr << "\t         \tor as few as round trip if 0; default 6"	<< std::endl;
+	std::cerr << "\t-r       \tRe-evaluate variables defined by assignment when"	<< std::endl;
+	std::cerr << "\t         \tthe variables they read change"			<< std::endl;
 	std::cerr << "\t-V       \tDispay the version"						<< std::endl;
+	std::cerr << "\t--cache dir\tSave -f files compiled in dir, and run them from"	<< std::endl;
+	std::cerr << "\t         \tthere, while they're unchanged"		<< std::endl;
+	std::cerr << "\t--csv expr... file\tEvaluate each expr for every row of the CSV"	<< std::endl;
+	std::cerr << "\t         \tfile, its columns bound to the variables named"	<< std::endl;
+	std::cerr << "\t         \tby its first row, writing a column per expr; on"	<< std::endl;
+	std::cerr << "\t         \t-j jobs threads, or one per CPU"		<< std::endl;
+	std::cerr << "\t--errors=json\tWrite diagnostics as JSON lines; line, column,"	<< std::endl;
+	std::cerr << "\t         \tcode (lexical, syntax or runtime) and message"	<< std::endl;
+	std::cerr << "\t--pipeline\tScan large files, and write results, on threads"	<< std::endl;
+	std::cerr << "\t         \tof their own"						<< std::endl;
+	std::cerr << "\t--serve socket\tServe sessions on the Unix domain socket"	<< std::endl;
+	std::cerr << "\t--stats[=json]\tReport timing and counters, as text or JSON, to"	<< std::endl;
+	std::cerr << "\t         \tstandard error at exit, and on SIGUSR1"	<< std::endl;
+}
+
+/// Request a statistics report; SIGUSR1
+static void requestStats(int) {
+	Stats::requested = 1;
+}
+
+/// Report the driver's statistics, if any, to standard error; returns nerrors
+static int reportStats(Driver& driver, int nerrors) {
+	if (driver.stats) {
+		driver.out.flush();
+		driver.err.flush();
+		driver.stats->report(driver, std::cerr);
+	}
+	return nerrors;
 }
 
 /** Parse the contents of of a string
  *
  *	@param	Driver	The parser driver
- *	@param	s		The string to parse
+ *	@param	s		The string to parse; scanned in place
  *
  *	@return	the number of errors encountered.
  */
-static int parseString(Driver& driver, const std::string s) {
-	driver.set_input(new std::istringstream{s});
+static int parseString(Driver& driver, const char* s) {
+	driver.set_input(s, std::strlen(s));
 	return driver.parse();
 }
 
@@ -50,26 +98,103 @@ static int parseString(Driver& driver, const std::string s) {
  *
  *	@param	Driver	The parser drvier
  *	@param	file	The name of the file to read, or "-" if standard input should be read.
+ *	@param	cache	If not null, run the file's compiled statements from here, if they're there
  *
  *	@return The number of errors encountered, EXIT_FAILURE if the file couldn't be open.
  */
-static int parseFile(Driver& driver, const std::string file) {
-	if ("-" == file)
-		driver.set_input(std::cin);
+static int parseFile(Driver& driver, const std::string file, const ScriptCache* cache) {
+	Source* src = openSource(file);		// memory mapped, if possible
 
-	else {
-		std::ifstream ifile(file);
+	if (!src) {
+		driver.out.flush();
+		driver.err << driver.progName << ": error opening \'" << file << "\'\n";
+		driver.err.flush();
+		return EXIT_FAILURE;
+	}
+
+	if (cache)
+		return cache->parse(driver, src);
+
+	driver.set_input(src);
+	return driver.parse();
+}
 
-		if (!ifile.is_open()) {
-			std::cerr << driver.progName << ": error opening \'" << file << "\'" << std::endl;
-			return EXIT_FAILURE;
+/** Parse the contents of files concurrently
+ *
+ *	Each file is parsed by a driver, and symbol table, of its own on one of up
+ *	to jobs threads. Each file's output is captured, and written in order, once
+ *	it, and the files before it, are complete. The n'th file's random numbers
+ *	are stream n, so they don't depend on the scheduling of the threads. Each
+ *	file's statistics, if the driver has any, are merged into the driver's.
+ *
+ *	@param	driver	The parser driver; supplies the program name, and options
+ *	@param	files	The files to read
+ *	@param	jobs	Maximum number of threads
+ *	@param	cache	Compiled scripts, or null
+ *
+ *	@return The total number of errors encountered, with EXIT_FAILURE for each
+ *			file that couldn't be opened.
+ */
+static int parseFiles(Driver& driver, const std::vector<std::string>& files, unsigned jobs,
+		const ScriptCache* cache) {
+	struct Job {
+		Transcript	transcript;				///< The file's output
+		Stats		stats;					///< The file's statistics, if driver's
+		int			nerrors = 0;			///< The file's error count
+		bool		done = false;			///< Complete?
+	};
+
+	std::vector<Job> results(files.size());
+	std::atomic<size_t> next{0};
+	std::mutex mutex;
+	std::condition_variable done;
+
+	auto worker = [&]() {
+		for (size_t i; (i = next++) < files.size(); ) {
+			Job& job = results[i];
+			{
+				Driver d(driver.progName, &job.transcript);
+				d.out.precision(driver.out.precision());
+				d.jit = driver.jit;
+				d.reactive = driver.reactive;
+				d.memoize = driver.memoize;
+				d.jsonErrors = driver.jsonErrors;
+				d.pipelined = driver.pipelined;
+				d.random.stream(i);
+				if (driver.stats)
+					d.stats = &job.stats;
+				job.nerrors = parseFile(d, files[i], cache);
+				job.stats.collect(d);
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			job.done = true;
+			done.notify_all();
 		}
+	};
 
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < jobs && i < files.size(); ++i)
+		threads.emplace_back(worker);
 
-		driver.set_input(new std::ifstream{file});
+	int nerrors = 0;
+	for (Job& job : results) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [&job]() { return job.done; });
+		}
+
+		job.transcript.replay();
+		job.transcript = Transcript();		// release the output
+		nerrors += job.nerrors;
+		if (driver.stats)
+			driver.stats->merge(job.stats);
 	}
 
-	return driver.parse();
+	for (std::thread& t : threads)
+		t.join();
+
+	return nerrors;
 }
 
 /**************************************************************************************************
@@ -79,8 +204,13 @@ static int parseFile(Driver& driver, const std::string file) {
 /// Run the calculator; read standard input or driectly from command line parameter(s)
 int main(int argc, char* argv[]) {
 	Driver	driver(argv[0]);
+	Stats	stats;								// if --stats
 
 	int nerrors = 0;							// Number of errors encountered...
+	int nparallel = 0;							// ...and by files parsed concurrently
+	unsigned jobs = 0;							// Concurrent -f files, if not 0
+	std::vector<std::string> files;				// Pending -f files, if jobs
+	std::unique_ptr<ScriptCache> cache;			// Compiled -f files, if --cache
 
 	if (1 == argc)
 		nerrors = driver.parse();				// Read from standard input
@@ -92,8 +222,13 @@ int main(int argc, char* argv[]) {
 			if (0 == arg.size())
 				continue;						// skip empty arguments...
 
+			if (!files.empty() && "-f" != arg) {
+				nparallel += parseFiles(driver, files, jobs, cache.get());
+				files.clear();
+			}
+
 			if ("-e" == arg) {					// -e expr - read from argument string
-				if (argn == argc) {	
+				if (argn + 1 == argc) {	
 					std::cerr << driver.progName << ": -e expr is missing expression string!" << std::endl;
 					return EXIT_FAILURE;
 
@@ -101,12 +236,15 @@ int main(int argc, char* argv[]) {
 					nerrors = parseString(driver, argv[++argn]);
 
 			} else if ("-f" == arg) {		// -f file - read from a file
-				if (argn == argc) {	
+				if (argn + 1 == argc) {	
 					std::cerr << driver.progName << ": -f file is missing file name!" << std::endl;
 					return EXIT_FAILURE;
 
-				} else 
-					nerrors = parseFile(driver, argv[++argn]);
+				} else if (jobs)
+					files.push_back(argv[++argn]);
+
+				else
+					nerrors = parseFile(driver, argv[++argn], cache.get());
 
 			
 											// -h help - display help message and exit
@@ -114,14 +252,88 @@ int main(int argc, char* argv[]) {
 				help(driver.progName);
 				return nerrors;
 
+			} else if ("-J" == arg)			// -J - enable the JIT
+				driver.jit = true;
+
+			else if ("-j" == arg) {		// -j jobs - parse -f files concurrently
+				if (argn + 1 == argc) {
+					std::cerr << driver.progName << ": -j jobs is missing the number of jobs!" << std::endl;
+					return EXIT_FAILURE;
+
+				} else if (0 == (jobs = std::atoi(argv[++argn])))
+					jobs = std::max(1u, std::thread::hardware_concurrency());
+
+			} else if ("-m" == arg)			// -m - memoize builtins
+				driver.memoize = true;
+
+			else if ("-p" == arg) {		// -p digits - set the output precision
+				if (argn + 1 == argc) {
+					std::cerr << driver.progName << ": -p digits is missing the precision!" << std::endl;
+					return EXIT_FAILURE;
+
+				} else
+					driver.out.precision(std::atoi(argv[++argn]));
+
+			} else if ("-r" == arg)			// -r - reactive variables
+				driver.reactive = true;
+
+			else if ("--cache" == arg) {	// --cache dir - cache compiled -f files
+				if (argn + 1 == argc) {
+					std::cerr << driver.progName << ": --cache dir is missing the directory!" << std::endl;
+					return EXIT_FAILURE;
+				}
+				cache.reset(new ScriptCache(argv[++argn]));
+
+			} else if ("--csv" == arg) {	// --csv expr... file - evaluate expr for each row
+				if (argc - argn < 3) {
+					std::cerr << driver.progName << ": --csv expr... file is missing the expression or file!" << std::endl;
+					return EXIT_FAILURE;
+				}
+
+				const std::vector<std::string> exprs(argv + argn + 1, argv + argc - 1);
+				int status;
+				{
+					Csv csv(driver, exprs, jobs ? jobs : std::thread::hardware_concurrency());
+					status = csv(driver, argv[argc - 1]);
+				}
+				return reportStats(driver, nerrors + nparallel + status);
+
+			} else if ("--errors=json" == arg)	// --errors=json - JSON lines diagnostics
+				driver.jsonErrors = true;
+
+			else if ("--pipeline" == arg) {	// --pipeline - scan, and write, concurrently
+				driver.pipelined = true;
+				driver.out.background(true);
+
+			} else if ("--serve" == arg) {	// --serve socket - serve sessions
+				if (argn + 1 == argc) {
+					std::cerr << driver.progName << ": --serve socket is missing the socket path!" << std::endl;
+					return EXIT_FAILURE;
+				}
+
+				int status;
+				{
+					Server server(driver, argv[++argn]);
+					status = server();
+				}
+				return reportStats(driver, status);
+
+			} else if ("--stats" == arg || "--stats=json" == arg) {	// --stats - report statistics
+				stats.asJson = "--stats=json" == arg;
+				driver.stats = &stats;
+				std::signal(SIGUSR1, requestStats);
+
 			} else if ("-V" == arg)			// -V - dispay version number
 				std::cout << "version: 1.0" << std::endl;
 
 			else 							// read from argument string
-				nerrors = parseString(driver, arg);
+				nerrors = parseString(driver, argv[argn]);
 		}
+
+		if (!files.empty())
+			nparallel += parseFiles(driver, files, jobs, cache.get());
 	}
 
-	return nerrors;
+	return reportStats(driver, nerrors + nparallel);
 };
 
@@ -0,0 +1,262 @@
+/** @file code.cpp
+ *
+ *	@brief	class Code implementation
+ *
+ *	Compiles parse trees into stack based byte-code.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#include "code.h"
+#include "jit.h"
+
+// private:
+
+/// Adjust the compile time stack depth by n, tracking the maximum depth
+void Code::push(int n) {
+	assert(n >= 0 || sp >= unsigned(-n));
+
+	sp += n;
+	if (sp > depth)
+		depth = sp;
+}
+
+/// Count the parents of each node in the tree at root
+void Code::count(const Tree& tree, NodeRef root) {
+	if (nilNode == root || refs[root]++)
+		return;							// nothing there, or already counted
+
+	const Node& n = tree[root];
+	switch(n.op) {
+	case Op::number:
+	case Op::integer:
+	case Op::variable:
+	case Op::call0:
+	case Op::arg:
+	case Op::file:
+		break;
+
+	case Op::range:
+		count(tree, n.step);
+		// fall through
+
+	default:
+		count(tree, n.left);
+		count(tree, n.right);
+		break;
+	}
+}
+
+/** Append the code to evaluate a node, leaving its value on the stack
+ *
+ *	Nodes with more than one parent are evaluated once, and saved in a
+ *	temporary, and restored from it thereafter. Literals and variables are
+ *	cheaper to push again.
+ *
+ *	@param	tree	The parse tree
+ *	@param	root	The (sub)tree to compile
+ *
+ *	@return	*this
+ */
+Code& Code::node(const Tree& tree, NodeRef root) {
+	if (noTemp != temp[root])
+		return emit(OpCode::restore, temp[root]);
+
+	operation(tree, root);
+
+	const Op op = tree[root].op;
+	if (refs[root] > 1 && op != Op::number && op != Op::integer && op != Op::variable) {
+		temp[root] = temps++;
+		emit(OpCode::save, temp[root]);
+	}
+
+	return *this;
+}
+
+/** Append the code to evaluate a node's operation, leaving its value on the stack
+ *
+ *	@param	tree	The parse tree
+ *	@param	root	The (sub)tree to compile
+ *
+ *	@return	*this
+ */
+Code& Code::operation(const Tree& tree, NodeRef root) {
+	const Node& n = tree[root];
+
+	switch(n.op) {
+	case Op::number:	return emit(OpCode::push, constant(n.value));
+	case Op::integer:	return emit(OpCode::pushi, constant(n.integer));
+	case Op::variable:	return emit(OpCode::load, n.sym);
+	case Op::assign:	return node(tree, n.left).emit(OpCode::store, n.sym);
+	case Op::neg:		return node(tree, n.left).emit(OpCode::neg);
+	case Op::add:		return node(tree, n.left).node(tree, n.right).emit(OpCode::add);
+	case Op::sub:		return node(tree, n.left).node(tree, n.right).emit(OpCode::sub);
+	case Op::mul:		return node(tree, n.left).node(tree, n.right).emit(OpCode::mul);
+	case Op::div:		return node(tree, n.left).node(tree, n.right).emit(OpCode::div);
+	case Op::mod:		return node(tree, n.left).node(tree, n.right).emit(OpCode::mod);
+	case Op::pow:		return node(tree, n.left).node(tree, n.right).emit(OpCode::pow);
+	case Op::lt:		return node(tree, n.left).node(tree, n.right).emit(OpCode::lt);
+	case Op::le:		return node(tree, n.left).node(tree, n.right).emit(OpCode::le);
+	case Op::gt:		return node(tree, n.left).node(tree, n.right).emit(OpCode::gt);
+	case Op::ge:		return node(tree, n.left).node(tree, n.right).emit(OpCode::ge);
+	case Op::eq:		return node(tree, n.left).node(tree, n.right).emit(OpCode::eq);
+	case Op::ne:		return node(tree, n.left).node(tree, n.right).emit(OpCode::ne);
+	case Op::land:		return node(tree, n.left).node(tree, n.right).emit(OpCode::land);
+	case Op::lor:		return node(tree, n.left).node(tree, n.right).emit(OpCode::lor);
+	case Op::lnot:		return node(tree, n.left).emit(OpCode::lnot);
+	case Op::call0:		return emit(OpCode::call0, n.sym);
+	case Op::call1:		return node(tree, n.left).emit(OpCode::call1, n.sym);
+	case Op::call2:		return node(tree, n.left).node(tree, n.right).emit(OpCode::call2, n.sym);
+	case Op::callv:		return node(tree, n.left).emit(OpCode::callv, n.sym);
+	case Op::arg:		return emit(OpCode::arg, n.sym);
+	case Op::setarg:	return node(tree, n.left).emit(OpCode::setarg, n.sym);
+
+	case Op::call: {
+		unsigned short count = 0;
+		for (NodeRef l = n.left; l != nilNode; l = tree[l].right, ++count)
+			node(tree, tree[l].left);
+		push(-int(count));
+		emit(OpCode::call, n.sym);
+		code.back().count = count;
+		return *this;
+	}
+
+	case Op::vector: {
+		unsigned count = 0;
+		for (NodeRef l = n.left; l != nilNode; l = tree[l].right, ++count)
+			node(tree, tree[l].left);
+		return emit(OpCode::vector, count);
+	}
+
+	case Op::list:		break;			// only as part of a vector, or call
+
+	case Op::range:
+		node(tree, n.left).node(tree, n.right);
+		if (n.step == nilNode)
+			emit(OpCode::pushi, constant(int64_t(1)));
+		else
+			node(tree, n.step);
+		return emit(OpCode::range);
+
+	case Op::file:
+		strs.emplace_back(tree.str(n.str));
+		return emit(OpCode::file, unsigned(strs.size() - 1));
+	}
+
+	assert(false);						// unknown operation
+	return *this;
+}
+
+// public:
+
+/// Discard all instructions, constants, strings and native code
+void Code::clear() {
+	code.clear();
+	consts.clear();
+	ints.clear();
+	strs.clear();
+	hosts.clear();
+	hot.clear();
+	sp = depth = temps = 0;
+}
+
+/// Add value to the constant pool, returning its index
+unsigned Code::constant(double value) {
+	consts.push_back(value);
+	return unsigned(consts.size() - 1);
+}
+
+/// Add value to the integer constant pool, returning its index
+unsigned Code::constant(int64_t value) {
+	ints.push_back(value);
+	return unsigned(ints.size() - 1);
+}
+
+/** Append an instruction
+ *
+ *	@param	op	The operation code
+ *	@param	arg	The operand
+ *
+ *	@return	*this
+ */
+Code& Code::emit(OpCode op, unsigned arg) {
+	switch(op) {
+	case OpCode::push:
+	case OpCode::pushi:
+	case OpCode::load:
+	case OpCode::loadp:
+	case OpCode::call0:
+	case OpCode::call:
+	case OpCode::arg:
+	case OpCode::file:
+	case OpCode::restore:	push(1);	break;
+
+	case OpCode::vector:	push(1 - int(arg));	break;
+	case OpCode::range:		push(-2);	break;
+	case OpCode::ret:		push(-int(arg));	break;
+
+	case OpCode::add:
+	case OpCode::sub:
+	case OpCode::mul:
+	case OpCode::div:
+	case OpCode::mod:
+	case OpCode::pow:
+	case OpCode::lt:
+	case OpCode::le:
+	case OpCode::gt:
+	case OpCode::ge:
+	case OpCode::eq:
+	case OpCode::ne:
+	case OpCode::land:
+	case OpCode::lor:
+	case OpCode::call2:
+	case OpCode::print:
+	case OpCode::jz:
+	case OpCode::pop:		push(-1);	break;
+
+	default:							// store(p), setarg, neg, lnot, call1, callv, save, jump and halt
+		break;
+	}
+
+	code.push_back(Instr(op, arg));
+	return *this;
+}
+
+/** Append the code to evaluate a parse tree, leaving its value on the stack
+ *
+ *	@param	tree	The parse tree
+ *	@param	root	The tree to compile
+ *
+ *	@return	*this
+ */
+Code& Code::emit(const Tree& tree, NodeRef root) {
+	refs.assign(tree.size(), 0);
+	temp.assign(tree.size(), noTemp);
+	count(tree, root);
+
+	return node(tree, root);
+}
+
+/** Bind variables to host variables
+ *
+ *	Loads of, and stores to, each symbol s for which vars[s] isn't null, become
+ *	loads from, and stores to, *vars[s] directly.
+ *
+ *	@param	vars	Host variables, by SymbolId
+ */
+void Code::bind(const std::vector<double*>& vars) {
+	for (Instr& in : code) {
+		if ((in.op != OpCode::load && in.op != OpCode::store) || in.arg >= vars.size() || !vars[in.arg])
+			continue;
+
+		double* const p = vars[in.arg];
+		const auto i = std::find(hosts.begin(), hosts.end(), p);
+		in.op = in.op == OpCode::load ? OpCode::loadp : OpCode::storep;
+		in.arg = unsigned(i - hosts.begin());
+		if (i == hosts.end())
+			hosts.push_back(p);
+	}
+}
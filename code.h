@@ -0,0 +1,143 @@
+/** @file code.h
+ *
+ *	@brief	enum OpCode, struct Instr and class Code
+ *
+ *	Compiled, stack based, byte-code statements; the output of the Parser and
+ *	the input of the VM.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef CODE_H
+#define CODE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "symbol.h"
+
+class Native;
+
+/************************************************************************************************
+ *	Operation codes																				*
+ ************************************************************************************************/
+
+/// Virtual machine operation codes
+enum class OpCode : unsigned char {
+	push,								///< Push consts[arg]
+	pushi,								///< Push ints[arg]
+	load,								///< Push the value of symbol arg
+	store,								///< symbol arg = top of stack; leaves value on the stack
+	loadp,								///< Push the value of host variable *hosts[arg]
+	storep,								///< *hosts[arg] = top of stack; leaves value on the stack
+	neg,								///< Negate top of stack
+	add,								///< Pop right, left; push left + right
+	sub,								///< Pop right, left; push left - right
+	mul,								///< Pop right, left; push left * right
+	div,								///< Pop right, left; push left / right
+	mod,								///< Pop right, left; push left % right
+	pow,								///< Pop right, left; push left ^ right
+	lt,									///< Pop right, left; push left < right
+	le,									///< Pop right, left; push left <= right
+	gt,									///< Pop right, left; push left > right
+	ge,									///< Pop right, left; push left >= right
+	eq,									///< Pop right, left; push left == right
+	ne,									///< Pop right, left; push left != right
+	land,								///< Pop right, left; push left && right
+	lor,								///< Pop right, left; push left || right
+	lnot,								///< Replace top of stack with !top
+	call0,								///< Push the value of builtin arg()
+	call1,								///< Replace top of stack with builtin1 arg(top)
+	call2,								///< Pop right, left; push builtin2 arg(left, right)
+	callv,								///< Replace top of stack with builtinv arg(top)
+	call,								///< Pop count arguments, push the value of function arg
+	ret,								///< Return from a function; pop its value if arg
+	arg,								///< Push argument arg ($arg)
+	setarg,								///< Argument arg = top of stack; leaves value on the stack
+	jump,								///< Continue at code[arg]
+	jz,									///< Pop; if zero, continue at code[arg]
+	vector,								///< Pop arg values, push their concatenation
+	range,								///< Pop step, last, first; push [first:last:step]
+	file,								///< Push the vector loaded from strs[arg]
+	save,								///< Copy the top of stack to temporary arg
+	restore,							///< Push temporary arg
+	print,								///< Pop, save in symbol arg and print the value
+	pop,								///< Pop and discard the top of stack
+	halt								///< End of code
+};
+
+/// A single instruction; an operation code and its operand
+struct Instr {
+	OpCode		op;						///< Operation code
+	unsigned short count;				///< op == call; number of arguments
+	unsigned	arg;					///< Operand; an index into consts, strs or code, a SymbolId or a count
+
+	/// Construct an instruction
+	Instr(OpCode o, unsigned a = 0, unsigned short n = 0) : op{o}, count{n}, arg{a} {}
+};
+
+/************************************************************************************************
+ *	Compiled code																				*
+ ************************************************************************************************/
+
+/** A compiled statement; instructions, and the constants and strings they refer to
+ *
+ *	Trees may be DAGs; a node with more than one parent is evaluated once, and
+ *	saved in a temporary for the rest. Statements with loops, and conditionals,
+ *	are compiled one expression at a time, joined by jumps that the Parser
+ *	emits, and patches, itself; the stack is empty at each jump.
+ *
+ *	Function and procedure bodies are Code too, called with their arguments on
+ *	the stack.
+ */
+class Code {
+public:
+	/// An expression that may be run natively; how often it's been reached, and its native code
+	struct Hot {
+		unsigned				runs = 0;	///< Times reached
+		std::shared_ptr<Native>	native;		///< Natively compiled code, if any
+	};
+
+private:
+	static constexpr unsigned noTemp = ~0u;	///< Not (yet) saved in a temporary
+
+	unsigned sp;						///< Stack depth while compiling
+	std::vector<unsigned>	refs;		///< By NodeRef; number of parents
+	std::vector<unsigned>	temp;		///< By NodeRef; the temporary holding its value
+
+	void push(int n);
+	void count(const Tree& tree, NodeRef root);
+	Code& node(const Tree& tree, NodeRef root);
+	Code& operation(const Tree& tree, NodeRef root);
+
+public:
+	std::vector<Instr>		code;		///< The instructions
+	std::vector<double>		consts;		///< Constant pool
+	std::vector<int64_t>	ints;		///< Integer constant pool
+	std::vector<std::string> strs;		///< String pool
+	std::vector<double*>	hosts;		///< Host variables, bound by pointer
+	unsigned				depth;		///< Maximum stack depth required
+	unsigned				temps;		///< Number of temporaries required
+
+	mutable std::vector<Hot>	hot;	///< By instruction, where expressions begin; by the VM
+
+	/// Construct an empty statement
+	Code() : sp{0}, depth{0}, temps{0} {}
+
+	void clear();
+	unsigned constant(double value);
+	unsigned constant(int64_t value);
+	Code& emit(OpCode op, unsigned arg = 0);
+	Code& emit(const Tree& tree, NodeRef root);
+	void bind(const std::vector<double*>& vars);
+
+	/// Index of the next instruction; a jump target
+	unsigned here() const				{	return unsigned(code.size());	}
+
+	/// Set the target of the jump at code[at] to here()
+	void patch(unsigned at)				{	code[at].arg = here();	}
+};
+
+#endif
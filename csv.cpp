@@ -0,0 +1,413 @@
+/** @file csv.cpp
+ *
+ *	@brief	class Csv implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "csv.h"
+#include "libcalc.h"
+
+/// Return the end of the last whole row in the n bytes at s, or 0 if there isn't one
+static size_t boundary(const char* s, size_t n) {
+	if (!std::memchr(s, '"', n)) {
+		const void* nl = memrchr(s, '\n', n);
+		return nl ? static_cast<const char*>(nl) - s + 1 : 0;
+	}
+
+	size_t end = 0;						// newlines within quotes don't end rows
+	bool quoted = false;
+	for (size_t i = 0; i < n; ++i)
+		if ('"' == s[i])
+			quoted = !quoted;
+		else if ('\n' == s[i] && !quoted)
+			end = i + 1;
+	return end;
+}
+
+/** Scan the field at p, and return its contents
+ *
+ *	Surrounding blanks are ignored. Quoted fields are unquoted into scratch,
+ *	and the newlines they contain added to lines.
+ *
+ *	@param	p		The field; updated to the comma or newline that ends it, or end
+ *	@param	end		End of the input
+ *	@param	scratch	Holds a quoted field's contents
+ *	@param	lines	Line count
+ */
+static std::string_view field(const char*& p, const char* end, std::string& scratch, unsigned& lines) {
+	while (p < end && (' ' == *p || '\t' == *p))
+		++p;
+
+	if (p < end && '"' == *p) {
+		scratch.clear();
+		for (++p; p < end; ++p) {
+			if ('"' == *p) {
+				if (p + 1 == end || '"' != p[1]) {
+					++p;
+					break;
+				}
+				++p;					// "" is a quote
+			} else if ('\n' == *p)
+				++lines;
+			scratch += *p;
+		}
+
+		while (p < end && ',' != *p && '\n' != *p)
+			++p;
+		return scratch;
+	}
+
+	const char* first = p;
+	while (p < end && ',' != *p && '\n' != *p)
+		++p;
+
+	const char* last = p;
+	while (last > first && (' ' == last[-1] || '\t' == last[-1] || '\r' == last[-1]))
+		--last;
+	return std::string_view(first, last - first);
+}
+
+/// Return s as a number, or NaN if it isn't one
+static double number(std::string_view s) {
+	if (!s.empty() && '+' == s[0])
+		s.remove_prefix(1);
+
+	double d;
+	const auto r = std::from_chars(s.data(), s.data() + s.size(), d);
+	return std::errc() == r.ec && r.ptr == s.data() + s.size() ? d : std::numeric_limits<double>::quiet_NaN();
+}
+
+/// Is s a variable name?
+static bool isName(const std::string& s) {
+	return !s.empty() && std::isalpha((unsigned char)s[0])
+		&& std::all_of(s.begin(), s.end(), [](char ch) { return std::isalnum((unsigned char)ch); });
+}
+
+/// Write s as a CSV field, quoted if need be
+static void quoted(Output& os, const std::string& s) {
+	if (s.find_first_of(",\"\r\n") == std::string::npos) {
+		os << s;
+		return;
+	}
+
+	os << '"';
+	for (char ch : s) {
+		if ('"' == ch)
+			os << '"';
+		os << ch;
+	}
+	os << '"';
+}
+
+// private:
+
+/** Read the next chunk of whole rows into text
+ *
+ *	At least chunk bytes are read, unless the input ends first, and then up to
+ *	the end of the last whole row; the rest is kept for the next chunk. A row
+ *	longer than a chunk is read whole.
+ *
+ *	@return	false if there's no more input
+ */
+bool Csv::read(std::string& text) {
+	text.swap(carry);
+	carry.clear();
+
+	size_t n = text.size();				// bytes read
+	while (!eof) {
+		if (n == text.size())
+			text.resize(n < chunk ? chunk : 2 * n);
+
+		const ssize_t got = ::read(fd, &text[n], text.size() - n);
+		if (got < 0 && EINTR == errno)
+			continue;
+
+		if (got <= 0) {
+			failed = got < 0;
+			eof = true;
+			break;
+		}
+
+		n += got;
+		if (n >= chunk) {
+			const size_t end = boundary(text.data(), n);
+			if (end) {
+				carry.assign(text, end, n - end);
+				text.resize(end);
+				return true;
+			}
+		}
+	}
+
+	text.resize(n);
+	return 0 != n;
+}
+
+/// Remove the column names from the start of the first chunk, c, into names
+void Csv::header(Chunk& c) {
+	const char* p = c.text.data();
+	const char* end = p + c.text.size();
+	if (end - p >= 3 && 0 == std::memcmp(p, "\xEF\xBB\xBF", 3))
+		p += 3;							// skip a UTF-8 byte order mark
+
+	std::string scratch;
+	unsigned lines = 1;
+	for (;;) {
+		names.emplace_back(field(p, end, scratch, lines));
+		if (p == end || ',' != *p)
+			break;
+		++p;
+	}
+
+	if (p < end) {
+		++p;
+		++lines;
+	}
+
+	c.line = lines;
+	c.text.erase(0, p - c.text.data());
+}
+
+/// Evaluate chunks, until there are no more; each thread's body
+void Csv::evaluate() {
+	Transcript transcript;
+	Driver driver(proto.progName, &transcript);
+	driver.out.precision(proto.out.precision());
+	driver.jsonErrors = proto.jsonErrors;
+
+	Calculator calc;
+	calc.jit(proto.jit);
+
+	std::vector<double> row(names.size(), std::numeric_limits<double>::quiet_NaN());
+	std::vector<bool> bound(names.size());
+	for (size_t i = 0; i < names.size(); ++i)
+		bound[i] = isName(names[i]) && calc.bind(names[i], &row[i]);
+
+	std::vector<const Calculator::Expression*> compiled;
+	for (const std::string& e : exprs)
+		compiled.push_back(calc.compile(e));
+	std::vector<double> results(compiled.size());
+
+	std::string scratch;
+	for (;;) {
+		Chunk* c;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			ready.wait(lock, [this]() { return !todo.empty() || finished; });
+			if (todo.empty())
+				return;
+			c = todo.front();
+			todo.pop_front();
+		}
+
+		const unsigned errors = driver.nErrors;
+		const char* p = c->text.data();
+		const char* const end = p + c->text.size();
+		for (unsigned line = c->line; p < end; ) {
+			const unsigned at = line;	// line the row began on
+
+			if ('\n' == *p || ('\r' == *p && p + 1 < end && '\n' == p[1])) {
+				p += '\r' == *p ? 2 : 1;	// skip empty rows
+				++line;
+				continue;
+			}
+
+			size_t col = 0;
+			for (;;) {
+				const std::string_view f = field(p, end, scratch, line);
+				if (col < row.size() && bound[col])
+					row[col] = number(f);
+				++col;
+
+				if (p == end || ',' != *p)
+					break;
+				++p;
+			}
+
+			if (p < end) {
+				++p;
+				++line;
+			}
+
+			for (; col < row.size(); ++col)
+				row[col] = std::numeric_limits<double>::quiet_NaN();
+
+			for (size_t i = 0; i < compiled.size(); ++i) {
+				results[i] = calc.evaluate(compiled[i]);
+				if (!calc.diagnostics().empty()) {
+					for (const Diagnostic& d : calc.diagnostics())
+						driver.report({ d.code, at, unsigned(i + 1), d.message });
+					driver.err.flush();	// ahead of the row's results
+					calc.clear();
+				}
+			}
+
+			for (size_t i = 0; i < results.size(); ++i) {
+				if (i)
+					driver.out << ',';
+				driver.out << results[i];
+			}
+			driver.out << '\n';
+		}
+
+		driver.out.flush();
+		driver.err.flush();
+		c->transcript = std::move(transcript);
+		transcript = Transcript();
+		c->nerrors = driver.nErrors - errors;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		c->done = true;
+		done.notify_all();
+	}
+}
+
+// public:
+
+/** Construct a CSV evaluator
+ *
+ *	@param	proto	Supplies the program name and options
+ *	@param	exprs	The expressions to evaluate for each row
+ *	@param	jobs	Threads evaluating rows; at least one
+ */
+Csv::Csv(const Driver& proto, const std::vector<std::string>& exprs, unsigned jobs)
+	: proto{proto}, exprs{exprs}, jobs{std::max(1u, jobs)}, fd{-1}, eof{false}, failed{false}, finished{false} {
+}
+
+/** Evaluate the expressions for each row of file, writing the results to driver's output
+ *
+ *	@param	driver	Reports errors in the expressions, and writes the results' header
+ *	@param	file	The CSV file, or "-" for standard input
+ *
+ *	@return	The number of errors encountered, EXIT_FAILURE if the file couldn't be read
+ */
+int Csv::operator()(Driver& driver, const std::string& file) {
+	{
+		Calculator calc;				// report errors in the expressions just once
+		for (const std::string& e : exprs)
+			calc.compile(e);
+		for (const Diagnostic& d : calc.diagnostics())
+			driver.report(d);
+		if (!calc.diagnostics().empty()) {
+			driver.out.flush();
+			driver.err.flush();
+			return int(calc.diagnostics().size());
+		}
+	}
+
+	fd = "-" == file ? 0 : ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		driver.out.flush();
+		driver.err << driver.progName << ": error opening \'" << file << "\'\n";
+		driver.err.flush();
+		return EXIT_FAILURE;
+	}
+
+	std::unique_ptr<Chunk> first(new Chunk);
+	if (read(first->text)) {
+		header(*first);
+		for (size_t i = 0; i < exprs.size(); ++i) {
+			if (i)
+				driver.out << ',';
+			quoted(driver.out, exprs[i]);
+		}
+		driver.out << '\n';
+	}
+	driver.out.flush();
+	driver.err.flush();
+
+	std::vector<std::thread> threads;
+	if (!first->text.empty() || !eof)
+		for (unsigned i = 0; i < jobs; ++i)
+			threads.emplace_back(&Csv::evaluate, this);
+
+	std::deque<std::unique_ptr<Chunk>> pending;	// in flight, in order
+	std::vector<std::unique_ptr<Chunk>> spare;	// retired, for reuse
+	int nerrors = 0;
+
+	auto submit = [&](std::unique_ptr<Chunk> c) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			todo.push_back(c.get());
+			ready.notify_one();
+		}
+		pending.push_back(std::move(c));
+	};
+
+	auto retire = [&]() {
+		Chunk& c = *pending.front();
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [&c]() { return c.done; });
+		}
+
+		c.transcript.replay();
+		c.transcript = Transcript();	// release the output
+		nerrors += c.nerrors;
+		c.nerrors = 0;
+		c.done = false;
+		spare.push_back(std::move(pending.front()));
+		pending.pop_front();
+	};
+
+	if (!threads.empty()) {
+		unsigned line = first->line + std::count(first->text.begin(), first->text.end(), '\n');
+		submit(std::move(first));
+
+		for (;;) {
+			if (pending.size() >= 2 * jobs)
+				retire();
+
+			std::unique_ptr<Chunk> c;
+			if (spare.empty())
+				c.reset(new Chunk);
+			else {
+				c = std::move(spare.back());
+				spare.pop_back();
+			}
+
+			if (!read(c->text))
+				break;
+			c->line = line;
+			line += std::count(c->text.begin(), c->text.end(), '\n');
+			submit(std::move(c));
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished = true;
+		ready.notify_all();
+	}
+
+	while (!pending.empty())
+		retire();
+
+	for (std::thread& t : threads)
+		t.join();
+
+	if (fd)
+		::close(fd);
+
+	if (failed) {
+		driver.err << driver.progName << ": error reading \'" << file << "\'\n";
+		driver.err.flush();
+		nerrors += EXIT_FAILURE;
+	}
+
+	return nerrors;
+}
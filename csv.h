@@ -0,0 +1,79 @@
+/** @file csv.h
+ *
+ *	@brief	class Csv
+ *
+ *	Evaluates expressions for each row of a CSV file, on as many threads as
+ *	there are jobs.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef CSV_H
+#define CSV_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "driver.h"
+#include "output.h"
+
+/** A CSV evaluator
+ *
+ *	The first row names the columns; each later row's columns are bound to the
+ *	variables of the same names, and the expressions evaluated, writing one
+ *	row of results, one column per expression. Columns that aren't numbers, or
+ *	are missing, are NaN; those whose names aren't variable names are ignored.
+ *	Fields may be quoted, as RFC 4180 describes.
+ *
+ *	Input is read in large chunks of whole rows. Each chunk is evaluated by one
+ *	of up to jobs threads, each with a Calculator of its own, and its results
+ *	written once the chunks before it have been. Only a few chunks per thread
+ *	are in flight at a time, so memory is bounded whatever the input's size.
+ *	Runtime errors are reported at the row's line, and the expression's
+ *	column.
+ */
+class Csv {
+	/// A chunk of whole rows, and their results
+	struct Chunk {
+		std::string	text;				///< The rows
+		unsigned	line = 0;			///< Line the first row began on
+		Transcript	transcript;			///< Results and diagnostics
+		int			nerrors = 0;		///< Errors reported
+		bool		done = false;		///< Evaluated?
+	};
+
+	static const size_t chunk = 4 * 1024 * 1024;	///< Bytes read per chunk, at least
+
+	const Driver&	proto;				///< Supplies the program name and options
+	std::vector<std::string> exprs;		///< The expressions
+	std::vector<std::string> names;		///< The column names
+	unsigned		jobs;				///< Threads evaluating chunks
+	int				fd;					///< The input
+	bool			eof;				///< Read all of the input?
+	bool			failed;				///< Did reading the input fail?
+	std::string		carry;				///< A partial row, read with the last chunk
+
+	std::mutex		mutex;				///< Guards the rest
+	std::condition_variable	ready;		///< todo grew, or finished was set
+	std::condition_variable	done;		///< A chunk was evaluated
+	std::deque<Chunk*>	todo;			///< Chunks waiting to be evaluated
+	bool			finished;			///< No more chunks?
+
+	bool read(std::string& text);
+	void header(Chunk& c);
+	void evaluate();
+
+public:
+	Csv(const Driver& proto, const std::vector<std::string>& exprs, unsigned jobs);
+
+	Csv(const Csv&) = delete;
+	Csv& operator=(const Csv&) = delete;
+
+	int operator()(Driver& driver, const std::string& file);
+};
+
+#endif
@@ -0,0 +1,44 @@
+/** @file diagnostic.h
+ *
+ *	@brief	struct Diagnostic
+ *
+ *	An error report, with where it occured, and what kind of error it is.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef DIAGNOSTIC_H
+#define DIAGNOSTIC_H
+
+#include <string>
+
+/** An error report
+ *
+ *	Lexical and syntax errors are located at the offending token; runtime
+ *	errors at the start of the statement being executed. Lines and columns
+ *	count from 1.
+ */
+struct Diagnostic {
+	/// What kind of error
+	enum class Code : unsigned char {
+		lexical = 1,					///< Bad token or literal
+		syntax,							///< The statement is malformed, and wasn't executed
+		runtime							///< Detected evaluating the statement
+	};
+
+	Code			code;				///< Kind of error
+	unsigned		line;				///< Line number
+	unsigned		column;				///< Column number
+	std::string		message;			///< What went wrong
+
+	/// Return code's name
+	static const char* name(Code code) {
+		switch(code) {
+		case Code::lexical:		return "lexical";
+		case Code::syntax:		return "syntax";
+		default:				return "runtime";
+		}
+	}
+};
+
+#endif
@@ -9,6 +9,10 @@
 #include <iostream>
 #include <limits>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
 #include "driver.h"
 
 // private:
@@ -22,31 +26,192 @@ std::string Driver::fileName(const std::string path) {
 	return std::string::npos != n ? path.substr(n+1, std::string::npos) : path;
 }
 
+/// Do file descriptors fd1 and fd2 refer to the same file?
+bool Driver::sameFile(int fd1, int fd2) {
+	struct stat s1, s2;
+	return 0 == fstat(fd1, &s1) && 0 == fstat(fd2, &s2) && s1.st_dev == s2.st_dev && s1.st_ino == s2.st_ino;
+}
+
+/** Execute code, compiled at t if stats
+ *
+ *	Results, and diagnostics, are written once the buffer fills, or at the end
+ *	of the input, unless interactive. If stats is set, execution is timed, and
+ *	a report requested by SIGUSR1 is written to standard error at the end of the
+ *	statement.
+ */
+void Driver::execute(Code& code, uint64_t t) {
+	vm(code);
+	if (reactive)
+		reactor(code);
+
+	if (stats) {
+		stats->evaluating += Stats::ticks() - t;
+		++stats->statements;
+		if (Stats::requested) {
+			Stats::requested = 0;
+			out.flush();
+			err.flush();
+			stats->report(*this, std::cerr);
+		}
+	}
+
+	if (interactive) {
+		err.flush();
+		out.flush();
+	} else if (transcribed && !err.empty())
+		err.flush();					// keep the transcript in order
+}
+
 // public:
 
 /** Constructor
+ *
+ *	Diagnostics are written with the results if standard output and standard
+ *	error are the same file, keeping the two in order without extra writes.
  *
  * @param	name 	The parsers name
+ * @param	t		If not null, capture results and diagnostics here
  */
-Driver::Driver(const std::string& name) : ts{*this, std::cin}, parser{*this}, progName{fileName(name)} {
+Driver::Driver(const std::string& name, Transcript* t)
+	: out{1, t}, err{2, t}, transcribed{nullptr != t}, shared{!t && sameFile(1, 2)},
+	  interactive{!t && 0 != isatty(1)}, jsonErrors{false}, pipelined{false}, jit{false}, reactive{false},
+	  memoize{false}, quiet{false}, stats{nullptr}, script{nullptr}, diagnostics{nullptr},
+	  ts{*this}, parser{*this}, vm{*this}, reactor{*this}, progName{fileName(name)} {
 	nErrors = 0;
 	lineNum = 1;
+	stage = Diagnostic::Code::runtime;
+	stmtLine = stmtColumn = 1;
 }
 
-/// Report an error and return NaN
-double Driver::error(const std::string& s) {
-	std::cerr << progName << ": " << s << " near line " << lineNum << std::endl;
+/** Parse, compile and execute input, a statement at a time...
+ *
+ *	If script is set, each statement is recorded as it's compiled.
+ *
+ *	@return The number of errors encountered.
+ */
+unsigned Driver::parse() {
+	Code code;
+
+	for (;;) {
+		uint64_t t = 0, lexed = 0;		// when stats; compiling began, lexing before
+		if (stats) {
+			t = Stats::ticks();
+			lexed = stats->lexing;
+		}
+
+		if (script)
+			script->statements.emplace_back();
+		const bool more = compile(code);
+		if (stats) {
+			const uint64_t now = Stats::ticks();
+			stats->parsing += now - t - (stats->lexing - lexed);
+			stats->scratch(parser.bytes());
+			t = now;
+		}
+		if (script)
+			script->record(*this, code);
+		if (!more)
+			break;
+
+		execute(code, t);
+	}
+
+	out.flush();
+	err.flush();
+	return nErrors;
+}
+
+/** Execute a script's compiled statements, as parse() would have
+ *
+ *	Its functions and procedures are defined, and its syntax errors reported,
+ *	as they would have been compiling each statement.
+ *
+ *	@return The number of errors encountered.
+ */
+unsigned Driver::run(Script& s) {
+	const unsigned base = lineNum;
+
+	for (Script::Statement& st : s.statements) {
+		for (Script::Definition& d : st.definitions)
+			parser.install(d.sym, d.kind, d.body);
+
+		for (Diagnostic d : st.diagnostics) {
+			d.line += base;
+			report(d);
+		}
+
+		stmtLine = st.line + base;
+		stmtColumn = st.column;
+		if (!st.code.code.empty())
+			execute(st.code, stats ? Stats::ticks() : 0);
+	}
+	lineNum = base + s.lines;
+
+	out.flush();
+	err.flush();
+	return nErrors;
+}
+
+/** Report d and return NaN
+ *
+ *	Diagnostics are buffered like results, as text, or as JSON lines if
+ *	jsonErrors. If they're written to a different file than the results, but
+ *	interactively, or to a transcript, results written before the statement's
+ *	first diagnostic are flushed first, so that the two stay in order. Those
+ *	reported while compiling are also recorded, if script is set. If
+ *	diagnostics is set, they're collected there instead of being written.
+ */
+double Driver::report(const Diagnostic& d) {
+	if (script && stage != Diagnostic::Code::runtime && !script->statements.empty()) {
+		script->statements.back().diagnostics.push_back(d);
+		script->statements.back().diagnostics.back().line -= script->base;
+	}
 
 	++nErrors;
+	if (diagnostics) {
+		diagnostics->push_back(d);
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+
+	Output& os = shared ? out : err;
+	if (!shared && (interactive || transcribed) && err.empty())
+		out.flush();
+
+	if (jsonErrors) {
+		os << "{\"line\":" << d.line << ",\"column\":" << d.column
+		   << ",\"code\":\"" << Diagnostic::name(d.code) << "\",\"message\":\"";
+		for (char ch : d.message) {
+			if (ch == '"' || ch == '\\')
+				os << '\\' << ch;
+			else if ((unsigned char)ch < ' ') {
+				static const char hex[] = "0123456789abcdef";
+				os << "\\u00" << hex[ch >> 4] << hex[ch & 15];
+			} else
+				os << ch;
+		}
+		os << "\"}\n";
+
+	} else
+		os << progName << ": " << d.message << " near line " << d.line << ", column " << d.column << '\n';
+
 	return std::numeric_limits<double>::quiet_NaN();
 }
 
+/// Report an error, at the current token if compiling, or the statement if executing, and return NaN
+double Driver::error(const std::string& s) {
+	if (stage == Diagnostic::Code::runtime)
+		return report({ stage, stmtLine, stmtColumn, s });
+
+	const Token& t = ts.current();
+	return report({ stage, t.line, t.column, s });
+}
+
 /// Report an error and return NaN
 double Driver::error(const std::string& s, char ch) {
 	return error(s + " \'" + ch + "\'");
 }
 
 /// Report an error and return NaN
-double Driver::error(const std::string& s, const std::string& t) {
-	return error(s + " \'" + t + "\'");
+double Driver::error(const std::string& s, std::string_view t) {
+	return error(s + " \'" + std::string(t) + "\'");
 }
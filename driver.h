@@ -12,46 +12,90 @@
 #define DRIVER_H
 
 #include <string>
+#include <vector>
 
+#include "code.h"
+#include "diagnostic.h"
+#include "output.h"
+#include "memo.h"
 #include "parser.h"
+#include "random.h"
+#include "reactor.h"
+#include "stats.h"
 #include "symbol.h"
 #include "token.h"
+#include "vm.h"
+
+struct Script;
 
 /** Calculator Parser Driver.
  *
  *	Maintains the state for, and coorinates of, the calculator parser,
- *  token-stream (scanner) and symbol table.
+ *  token-stream (scanner), virtual machine, symbol table and reactor.
  */
 
 class Driver {
 	static std::string fileName (const std::string path);
+	static bool sameFile(int fd1, int fd2);
+	void execute(Code& code, uint64_t t);
 
 public:
+	Output			out;				///< Results; standard output
+	Output			err;				///< Diagnostics; standard error
+	bool			transcribed;		///< Is output captured in a transcript?
+	bool			shared;				///< Are results and diagnostics written to the same file?
+	bool			interactive;		///< Flush results after every statement?
+	bool			jsonErrors;			///< Write diagnostics as JSON lines?
+	bool			pipelined;			///< Scan large inputs on a thread of their own?
+	bool			jit;				///< Run frequently executed statements natively?
+	bool			reactive;			///< Re-evaluate definitions as their inputs change?
+	bool			memoize;			///< Cache the results of pure builtins?
+	bool			quiet;				///< Save results in "last", without printing them?
+	Memo			memo;				///< Cached builtin results, if memoize
+	Random			random;				///< Random numbers; rand() and friends
+	Stats*			stats;				///< Statistics to gather, or null
+	Script*			script;				///< Record compiled statements here, or null
+	std::vector<Diagnostic>* diagnostics;	///< Collect diagnostics here, rather than writing them, or null
+
 	SymbolTable 	table;				///< The symbol table
 	TokenStream		ts;					///< The token-stream (scanner)
-	Parser			parser;				///< The parser
+	Parser			parser;				///< The parser (compiler)
+	VM				vm;					///< The virtual machine
+	Reactor			reactor;			///< Variable definitions, if reactive
 
 	std::string		progName;			///< The parser drivers name
 	unsigned		nErrors;			///< Number of errors seen to date
 	unsigned		lineNum;			///< The current line number
+	Diagnostic::Code stage;				///< syntax while compiling, runtime while executing
+	unsigned		stmtLine;			///< Line the statement being executed began on
+	unsigned		stmtColumn;			///< Column the statement being executed began at
 
-	Driver(const std::string& n);
+	Driver(const std::string& n, Transcript* t = nullptr);
 
 	/// Destructor
 	virtual ~Driver()	{}
 
-	/// Set the input stream to s
-	void set_input(std::istream& s)			{	ts.set_input(s);	}
+	/// Set the input to s, which the driver then owns
+	void set_input(Source* s)				{	ts.set_input(s);	}
 
-	/// Set the input stream to s
-	void set_input(std::istream* s)			{	ts.set_input(s);	}
+	/// Set the input to the n characters at s, which must outlive the input
+	void set_input(const char* s, size_t n)	{	ts.set_input(s, n);	}
 
+	double report(const Diagnostic& d);
 	double error(const std::string& s);
 	double error(const std::string& s, char ch);
-	double error (const std::string& s, const std::string& t);
+	double error (const std::string& s, std::string_view t);
+
+	/// Compile the next statement into code, returning false at the end of input
+	bool compile(Code& code) {
+		stage = Diagnostic::Code::syntax;
+		const bool more = parser(code);
+		stage = Diagnostic::Code::runtime;
+		return more;
+	}
 
-	/// Parse input...
-	unsigned parse()						{	return parser();	}
+	unsigned parse();
+	unsigned run(Script& s);
 };
 
 #endif
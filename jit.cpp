@@ -0,0 +1,431 @@
+/** @file jit.cpp
+ *
+ *	@brief	class Native implementation
+ *
+ *	A single pass translation of stack byte-code into x86-64 machine code
+ *	(System V ABI). The top of the evaluation stack is kept in xmm0, and the
+ *	rest in a stack frame, one slot per level. rbx holds the symbol table's
+ *	values, r12 the driver, for error reporting, and r13 the arguments.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "jit.h"
+#include "code.h"
+#include "driver.h"
+#include "math.h"
+#include "memo.h"
+
+#if defined(__x86_64__)
+
+/************************************************************************************************
+ *	Runtime support																				*
+ ************************************************************************************************/
+
+/// Report division by zero, returning NaN
+static double divideByZero(Driver* driver) {
+	return driver->error("divide by 0");
+}
+
+/// Return x % y, as the virtual machine does
+static double Remainder(double x, double y) {
+	return std::remainder(x, y);
+}
+
+/// Return memo(id, func, x)
+static double memo1(Memo* memo, SymbolId id, double (*func)(double), double x) {
+	return (*memo)(id, func, x);
+}
+
+/// Return memo(id, func, x, y)
+static double memo2(Memo* memo, SymbolId id, double (*func)(double, double), double x, double y) {
+	return (*memo)(id, func, x, y);
+}
+
+/************************************************************************************************
+ *	Assembler																					*
+ ************************************************************************************************/
+
+namespace {
+
+/// Just enough of an x86-64 assembler; xmm0 and xmm1 for operands, rax for addresses
+class Assembler {
+	/// Emit a 32-bit value
+	void imm32(uint32_t v)				{	for (int i = 0; i < 4; ++i) byte(v >> i * 8);	}
+
+	/// Emit a 64-bit value
+	void imm64(uint64_t v)				{	for (int i = 0; i < 8; ++i) byte(v >> i * 8);	}
+
+public:
+	std::vector<unsigned char>	buf;	///< The machine code
+
+	/// Emit one or more bytes
+	template<typename... Bytes>
+	void byte(Bytes... b)				{	(buf.push_back(static_cast<unsigned char>(b)), ...);	}
+
+	/// Push callee-saved rbx, r12 and r13, allocate frame bytes; rbx = slots, r12 = driver, r13 = args
+	void prologue(uint32_t frame) {
+		byte(0x53);										// push rbx
+		byte(0x41, 0x54);								// push r12
+		byte(0x41, 0x55);								// push r13
+		byte(0x48, 0x81, 0xec);	imm32(frame);			// sub rsp, frame
+		byte(0x48, 0x89, 0xfb);							// mov rbx, rdi
+		byte(0x49, 0x89, 0xf4);							// mov r12, rsi
+		byte(0x49, 0x89, 0xd5);							// mov r13, rdx
+	}
+
+	/// Release frame bytes, restore rbx, r12 and r13 and return xmm0
+	void epilogue(uint32_t frame) {
+		byte(0x48, 0x81, 0xc4);	imm32(frame);			// add rsp, frame
+		byte(0x41, 0x5d);								// pop r13
+		byte(0x41, 0x5c);								// pop r12
+		byte(0x5b);										// pop rbx
+		byte(0xc3);										// ret
+	}
+
+	/// movsd xmm, [rbx + disp]
+	void loadSlot(int xmm, uint32_t disp)	{	byte(0xf2, 0x0f, 0x10, 0x83 | xmm << 3);	imm32(disp);	}
+
+	/// cvtsi2sd xmm, qword [rbx + disp]
+	void convertSlot(int xmm, uint32_t disp)	{	byte(0xf2, 0x48, 0x0f, 0x2a, 0x83 | xmm << 3);	imm32(disp);	}
+
+	/// movsd xmm, [r13 + disp]
+	void loadArg(int xmm, uint32_t disp)	{	byte(0xf2, 0x41, 0x0f, 0x10, 0x85 | xmm << 3);	imm32(disp);	}
+
+	/// cvtsi2sd xmm, qword [r13 + disp]
+	void convertArg(int xmm, uint32_t disp)	{	byte(0xf2, 0x49, 0x0f, 0x2a, 0x85 | xmm << 3);	imm32(disp);	}
+
+	/// movsd xmm, [p], via rax
+	void loadAddress(int xmm, const void* p) {
+		byte(0x48, 0xb8);	imm64(reinterpret_cast<uintptr_t>(p));	// mov rax, p
+		byte(0xf2, 0x0f, 0x10, xmm << 3);						// movsd xmm, [rax]
+	}
+
+	/// movsd xmm, [rsp + disp]
+	void loadTemp(int xmm, uint32_t disp)	{	byte(0xf2, 0x0f, 0x10, 0x84 | xmm << 3, 0x24);	imm32(disp);	}
+
+	/// movsd [rsp + disp], xmm
+	void storeTemp(uint32_t disp, int xmm)	{	byte(0xf2, 0x0f, 0x11, 0x84 | xmm << 3, 0x24);	imm32(disp);	}
+
+	/// xmm = the bits v, via rax
+	void constant(int xmm, uint64_t v) {
+		byte(0x48, 0xb8);	imm64(v);					// mov rax, v
+		byte(0x66, 0x48, 0x0f, 0x6e, 0xc0 | xmm << 3);	// movq xmm, rax
+	}
+
+	/// Scalar double operation op (addsd, subsd...) of xmm0 and xmm1, into xmm0
+	void arith(unsigned char op)			{	byte(0xf2, 0x0f, op, 0xc1);	}
+
+	/// A packed double operation op (movapd, xorpd, ucomisd) of xmm s into xmm d
+	void packed(unsigned char op, int d, int s)	{	byte(0x66, 0x0f, op, 0xc0 | d << 3 | s);	}
+
+	/// mov reg, v; a 64-bit integer register
+	void integer(int reg, uint64_t v)		{	byte(0x48, 0xb8 | reg);	imm64(v);	}
+
+	/// Call f
+	void call(const void* f) {
+		byte(0x48, 0xb8);	imm64(reinterpret_cast<uintptr_t>(f));	// mov rax, f
+		byte(0xff, 0xd0);											// call rax
+	}
+
+	/// Conditional (0x0f 0x8?), or unconditional (0xe9) jump; return the offset to patch
+	size_t jump(unsigned char cc) {
+		if (cc == 0xe9)
+			byte(0xe9);
+		else
+			byte(0x0f, cc);
+		imm32(0);
+		return buf.size();
+	}
+
+	/// Patch the jump ending at at, to here
+	void patch(size_t at) {
+		const uint32_t rel = uint32_t(buf.size() - at);
+		std::memcpy(&buf[at - 4], &rel, 4);
+	}
+};
+
+enum : int {							// Integer argument registers
+	rdx = 2, rsi = 6, rdi = 7
+};
+
+enum : unsigned char {					// Operation codes
+	addsd = 0x58, mulsd = 0x59, subsd = 0x5c, divsd = 0x5e,
+	movapd = 0x28, ucomisd = 0x2e, xorpd = 0x57,
+	jne = 0x85, jp = 0x8a, jmp = 0xe9
+};
+
+}
+
+/************************************************************************************************
+ *	Native																						*
+ ************************************************************************************************/
+
+/// Destructor; release the executable memory
+Native::~Native() {
+	if (mem)
+		munmap(mem, len);
+}
+
+/** Compile the scalar expression that begins at code[start]
+ *
+ *	@param	code	The statement, or function body
+ *	@param	start	Index of the expression's first instruction
+ *	@param	table	The symbol table; supplies the builtins, and the variables' types
+ *	@param	argv	The arguments, $1...; supply their types
+ *	@param	nargs	Number of arguments
+ *	@param	memo	Cache for pure builtin calls, or null
+ *
+ *	@return	The compiled code, or null if no expression that can be compiled
+ *			begins at start
+ */
+std::shared_ptr<Native> Native::compile(const Code& code, size_t start, const SymbolTable& table,
+		const Value* argv, unsigned nargs, Memo* memo) {
+	const SymValue sample;
+	const size_t valueOffset = reinterpret_cast<const char*>(&sample.u.value)
+							 - reinterpret_cast<const char*>(&sample);
+	const Value arg;
+	const size_t numOffset = reinterpret_cast<const char*>(&arg.num) - reinterpret_cast<const char*>(&arg);
+	auto slot = [=](SymbolId id)	{	return uint32_t(id * sizeof(SymValue) + valueOffset);	};
+	auto argument = [=](unsigned n)	{	return uint32_t((n - 1) * sizeof(Value) + numOffset);	};
+	auto temp = [](unsigned d)		{	return uint32_t(d * sizeof(double));	};
+
+	const unsigned saved = code.depth;	// Temporaries follow the stack in the frame
+	uint32_t frame = uint32_t(std::max(code.depth + code.temps, 1u) * sizeof(double));
+	if (frame % 16)
+		frame += 8;						// keep rsp 16 byte aligned for calls
+
+	std::shared_ptr<Native> native(new Native);
+	Assembler a;
+	unsigned depth = 0;					// Entries on the evaluation stack
+	size_t i = start;
+
+	// Which entries, and temporaries, the virtual machine would hold as exact integers
+	std::vector<bool> exact(code.depth + 1), exactTemp(code.temps);
+	std::vector<bool> savedHere(code.temps);	// Temporaries saved by the native code
+
+	a.prologue(frame);
+	for (; i < code.code.size(); ++i) {
+		const Instr& in = code.code[i];
+
+		unsigned operands = 0;			// taken from the stack
+		bool leave = false;				// computed exactly by the virtual machine, or not a number?
+		switch(in.op) {
+		case OpCode::neg:		operands = 1; leave = depth && exact[depth - 1];		break;
+		case OpCode::save:		operands = 1;	break;
+		case OpCode::call1:		operands = 1; leave = table[in.arg].u.func1 == Integer;	break;
+		case OpCode::call2:		operands = 2;	break;
+		case OpCode::add:
+		case OpCode::sub:
+		case OpCode::mul:
+		case OpCode::div:
+		case OpCode::mod:
+		case OpCode::pow:		operands = 2; leave = depth > 1 && exact[depth - 1] && exact[depth - 2];	break;
+		case OpCode::restore:	leave = in.arg >= code.temps || !savedHere[in.arg];	break;	// not ours
+		case OpCode::load: {
+			const SymValue& s = table[in.arg];
+			leave = (s.kind != Kind::name && s.kind != Kind::constant) || s.vec;	// not a number
+			break;
+		}
+		case OpCode::arg:		leave = in.arg < 1 || in.arg > nargs || argv[in.arg - 1].vec;	break;
+		default:				break;
+		}
+		if (leave || depth < operands)
+			break;						// leave it to the virtual machine
+
+		switch(in.op) {
+		case OpCode::add:
+		case OpCode::sub:
+		case OpCode::mul:
+		case OpCode::div:
+		case OpCode::mod:
+		case OpCode::pow:
+		case OpCode::call2:
+			a.packed(movapd, 1, 0);						// right
+			a.loadTemp(0, temp(depth - 2));				// left
+			exact[--depth - 1] = false;					// one, or neither, operand was exact
+			break;
+
+		case OpCode::call1:
+			exact[depth - 1] = false;
+			break;
+
+		default:
+			break;
+		}
+
+		switch(in.op) {
+		case OpCode::push:
+		case OpCode::pushi:
+		case OpCode::load:
+		case OpCode::loadp:
+		case OpCode::arg:
+		case OpCode::call0:
+		case OpCode::restore:
+			if (depth)
+				a.storeTemp(temp(depth - 1), 0);
+			exact[depth++] = in.op == OpCode::pushi || (in.op == OpCode::restore && exactTemp[in.arg])
+				|| (in.op == OpCode::load && table[in.arg].exact) || (in.op == OpCode::arg && argv[in.arg - 1].exact);
+
+			if (in.op == OpCode::restore)
+				a.loadTemp(0, temp(saved + in.arg));
+
+			else if (in.op == OpCode::push || in.op == OpCode::pushi) {
+				const double value = in.op == OpCode::push ? code.consts[in.arg] : double(code.ints[in.arg]);
+				uint64_t bits;
+				std::memcpy(&bits, &value, sizeof bits);
+				a.constant(0, bits);
+
+			} else if (in.op == OpCode::load) {
+				if (exact[depth - 1])
+					a.convertSlot(0, slot(in.arg));
+				else
+					a.loadSlot(0, slot(in.arg));
+				native->loads.push_back({ in.arg, exact[depth - 1] });
+
+			} else if (in.op == OpCode::arg) {
+				if (exact[depth - 1])
+					a.convertArg(0, argument(in.arg));
+				else
+					a.loadArg(0, argument(in.arg));
+				native->args.push_back({ in.arg, exact[depth - 1] });
+
+			} else if (in.op == OpCode::loadp) {
+				a.loadAddress(0, code.hosts[in.arg]);
+
+			} else
+				a.call(reinterpret_cast<const void*>(table[in.arg].u.func));
+			continue;
+
+		case OpCode::save:
+			exactTemp[in.arg] = exact[depth - 1];
+			savedHere[in.arg] = true;
+			a.storeTemp(temp(saved + in.arg), 0);
+			continue;
+
+		case OpCode::neg:
+			a.constant(1, uint64_t(1) << 63);
+			a.packed(xorpd, 0, 1);
+			continue;
+
+		case OpCode::call1:
+			if (memo && table[in.arg].pure) {
+				a.integer(rdi, reinterpret_cast<uintptr_t>(memo));
+				a.integer(rsi, in.arg);
+				a.integer(rdx, reinterpret_cast<uintptr_t>(table[in.arg].u.func1));
+				a.call(reinterpret_cast<const void*>(memo1));
+			} else
+				a.call(reinterpret_cast<const void*>(table[in.arg].u.func1));
+			continue;
+
+		case OpCode::add:	a.arith(addsd);	continue;
+		case OpCode::sub:	a.arith(subsd);	continue;
+		case OpCode::mul:	a.arith(mulsd);	continue;
+		case OpCode::pow:	a.call(reinterpret_cast<const void*>(static_cast<double (*)(double, double)>(Pow)));	continue;
+
+		case OpCode::call2:
+			if (memo && table[in.arg].pure) {
+				a.integer(rdi, reinterpret_cast<uintptr_t>(memo));
+				a.integer(rsi, in.arg);
+				a.integer(rdx, reinterpret_cast<uintptr_t>(table[in.arg].u.func2));
+				a.call(reinterpret_cast<const void*>(memo2));
+			} else
+				a.call(reinterpret_cast<const void*>(table[in.arg].u.func2));
+			continue;
+
+		case OpCode::div:
+		case OpCode::mod: {
+			a.packed(xorpd, 2, 2);
+			a.packed(ucomisd, 1, 2);
+			const size_t nan = a.jump(jp);				// right is NaN; not zero
+			const size_t nonzero = a.jump(jne);
+			a.byte(0x4c, 0x89, 0xe7);					// mov rdi, r12
+			a.call(reinterpret_cast<const void*>(divideByZero));
+			const size_t done = a.jump(jmp);
+
+			a.patch(nan);
+			a.patch(nonzero);
+			if (in.op == OpCode::div)
+				a.arith(divsd);
+			else
+				a.call(reinterpret_cast<const void*>(Remainder));
+			a.patch(done);
+			continue;
+		}
+
+		default:
+			break;
+		}
+
+		break;							// the end of the expression, or not compilable
+	}
+
+	// Worthwhile only if there's something more than a single value to compute, as a double
+	if (depth != 1 || exact[0] || i < start + 2 || i >= code.code.size())
+		return nullptr;
+
+	switch(code.code[i].op) {			// followed by an assignment, print, pop, condition or return?
+	case OpCode::store:
+	case OpCode::storep:
+	case OpCode::print:
+	case OpCode::pop:
+	case OpCode::jz:
+		break;
+
+	case OpCode::ret:
+		if (code.code[i].arg)
+			break;
+		return nullptr;
+
+	default:
+		return nullptr;
+	}
+
+	for (size_t j = 0; j < code.code.size(); ++j)
+		if ((j < start || j >= i) && code.code[j].op == OpCode::restore && savedHere[code.code[j].arg])
+			return nullptr;				// the VM doesn't have the native temporaries
+
+	a.epilogue(frame);
+
+	const size_t page = sysconf(_SC_PAGESIZE);
+	native->len = (a.buf.size() + page - 1) / page * page;
+	void* mem = mmap(nullptr, native->len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == mem)
+		return nullptr;
+
+	native->mem = mem;
+	std::memcpy(mem, a.buf.data(), a.buf.size());
+	if (0 != mprotect(mem, native->len, PROT_READ | PROT_EXEC))
+		return nullptr;
+
+	auto unique = [](std::vector<Load>& v) {
+		std::sort(v.begin(), v.end(), [](const Load& x, const Load& y) { return x.id < y.id; });
+		v.erase(std::unique(v.begin(), v.end(), [](const Load& x, const Load& y) { return x.id == y.id; }), v.end());
+	};
+	unique(native->loads);
+	unique(native->args);
+	native->entry = reinterpret_cast<Function>(mem);
+	native->end = i;
+	return native;
+}
+
+#else
+
+/// Destructor
+Native::~Native() {
+}
+
+/// Not an x86-64; nothing's ever compiled
+std::shared_ptr<Native> Native::compile(const Code&, size_t, const SymbolTable&, const Value*, unsigned, Memo*) {
+	return nullptr;
+}
+
+#endif
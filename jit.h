@@ -0,0 +1,97 @@
+/** @file jit.h
+ *
+ *	@brief	class Native
+ *
+ *	Compiles scalar expressions, where they begin in a statement's, or a
+ *	function's, byte-code, into x86-64 machine code.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "symbol.h"
+#include "vm.h"
+
+class Code;
+class Driver;
+class Memo;
+
+/** A natively compiled expression
+ *
+ *	Covers code[start, end); numbers, variables, arguments, arithmetic and
+ *	calls to builtins with number arguments. The expression's value is
+ *	returned, and the virtual machine interprets the rest; its assignments,
+ *	conditions, returns and printing.
+ *
+ *	Variables are loaded from fixed offsets into the symbol table's values,
+ *	arguments from the caller's stack, host variables from their addresses, and
+ *	builtins are called directly, or via a Memo. Division by zero is reported
+ *	via the driver, as the virtual machine would. Variables, and arguments, are
+ *	compiled as the numbers, or exact integers, they were when compiled, and
+ *	the code is valid only while they still are; see ready(). Operations the
+ *	virtual machine would compute exactly, on integers, aren't compiled.
+ */
+class Native {
+public:
+	/// The compiled code; returns the value of the expression
+	typedef double (*Function)(const SymValue* slots, Driver* driver, const Value* args);
+
+private:
+	/// A variable, or argument, loaded; and was it an exact integer?
+	struct Load {
+		unsigned	id;					///< SymbolId, or argument number
+		bool		exact;				///< Loaded as an exact integer?
+	};
+
+	void*					mem;		///< Executable memory
+	size_t					len;		///< Length of mem
+	Function				entry;		///< The compiled code
+	std::vector<Load>		loads;		///< Variables loaded
+	std::vector<Load>		args;		///< Arguments loaded
+
+	Native() : mem{nullptr}, len{0}, entry{nullptr}, end{0} {}
+
+public:
+	/// Minimum number of executions before an expression is compiled
+	static const unsigned threshold = 8;
+
+	size_t					end;		///< Index of the first instruction not compiled
+
+	~Native();
+
+	Native(const Native&) = delete;
+	Native& operator=(const Native&) = delete;
+
+	static std::shared_ptr<Native> compile(const Code& code, size_t start, const SymbolTable& table,
+		const Value* args, unsigned nargs, Memo* memo);
+
+	/** May the code be run?
+	 *
+	 *	Each variable it loads must be a defined number, and each argument
+	 *	present, and a number; exact integers where they were when compiled.
+	 */
+	bool ready(const SymbolTable& table, const Value* argv, unsigned nargs) const {
+		for (const Load& l : loads) {
+			const SymValue& s = table[l.id];
+			if ((s.kind != Kind::name && s.kind != Kind::constant) || s.vec || s.exact != l.exact)
+				return false;
+		}
+		for (const Load& l : args)
+			if (l.id > nargs || argv[l.id - 1].vec || argv[l.id - 1].exact != l.exact)
+				return false;
+		return true;
+	}
+
+	/// Evaluate the expression, with the arguments args
+	double operator()(const SymbolTable& table, Driver& driver, const Value* argv) const {
+		return entry(table.data(), &driver, argv);
+	}
+};
+
+#endif
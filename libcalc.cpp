@@ -0,0 +1,145 @@
+/** @file libcalc.cpp
+ *
+ *	@brief	class Calculator implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <limits>
+#include <utility>
+
+#include "libcalc.h"
+#include "driver.h"
+
+/// A compiled expression; its statements, each with where it began
+class Calculator::Expression {
+public:
+	/// A compiled statement
+	struct Statement {
+		Code		code;				///< The statement
+		unsigned	line;				///< Line the statement began on
+		unsigned	column;				///< Column the statement began at
+	};
+
+	std::vector<Statement>	statements;	///< The statements, in order
+};
+
+/// A calculator's state
+struct Calculator::State {
+	std::vector<Diagnostic>	diagnostics;	///< Errors reported to date
+	Driver					driver;		///< The compiler, virtual machine and variables
+	const SymbolId			last;		///< "last"; the value of the last expression
+	std::vector<double*>	hosts;		///< Host variables, by SymbolId, or null
+	std::vector<std::unique_ptr<Expression>> expressions;	///< Compiled expressions
+
+	State() : driver{"calc"}, last{driver.table.intern("last")} {
+		driver.quiet = true;
+		driver.diagnostics = &diagnostics;
+	}
+};
+
+// public:
+
+/// Construct a calculator, with no variables, functions or procedures
+Calculator::Calculator() : state{new State} {
+}
+
+/// Destructor; compiled expressions are released
+Calculator::~Calculator() {
+}
+
+/// Compile frequently evaluated expressions to machine code, or not
+void Calculator::jit(bool on) {
+	state->driver.jit = on;
+}
+
+/** Bind name to the host variable *value
+ *
+ *	Expressions compiled after, that refer to name, read and write *value
+ *	directly; those compiled before are unaffected.
+ *
+ *	@param	name	The variable's name
+ *	@param	value	The host variable; must outlive the expressions that use it
+ *
+ *	@return	false if name is a constant, builtin or keyword
+ */
+bool Calculator::bind(std::string_view name, double* value) {
+	if (SymbolTable::builtin(name) != noSymbol)
+		return false;
+
+	const SymbolId id = state->driver.table.intern(name);
+	if (state->hosts.size() <= id)
+		state->hosts.resize(id + 1, nullptr);
+	state->hosts[id] = value;
+	return true;
+}
+
+/** Compile text
+ *
+ *	Functions and procedures that text defines are defined now, and may be
+ *	called by expressions compiled later.
+ *
+ *	@param	text	Statements; needn't outlive the call
+ *
+ *	@return	The compiled expression, valid as long as the calculator, or null
+ *			if text has errors; see diagnostics()
+ */
+const Calculator::Expression* Calculator::compile(std::string_view text) {
+	Driver& driver = state->driver;
+	const unsigned errors = driver.nErrors;
+	std::unique_ptr<Expression> expr(new Expression);
+
+	driver.lineNum = 1;
+	driver.set_input(text.data(), text.size());
+	for (Code code; ; code = Code()) {
+		const bool more = driver.compile(code);
+		for (SymbolId sym : driver.parser.definitions())
+			driver.parser.body(sym).bind(state->hosts);
+		if (!more)
+			break;
+
+		code.bind(state->hosts);
+		expr->statements.push_back({ std::move(code), driver.stmtLine, driver.stmtColumn });
+	}
+
+	if (driver.nErrors != errors)
+		return nullptr;
+
+	state->expressions.push_back(std::move(expr));
+	return state->expressions.back().get();
+}
+
+/// Evaluate expr, returning its value, or NaN if it has none, or expr is null
+double Calculator::evaluate(const Expression* expr) {
+	if (!expr)
+		return std::numeric_limits<double>::quiet_NaN();
+
+	Driver& driver = state->driver;
+	driver.table[state->last] = std::numeric_limits<double>::quiet_NaN();
+	for (const Expression::Statement& s : expr->statements) {
+		driver.stmtLine = s.line;
+		driver.stmtColumn = s.column;
+		driver.vm(s.code);
+	}
+
+	return driver.table[state->last];
+}
+
+/// Return the value of the variable name, or NaN if it's undefined, or not a number
+double Calculator::value(std::string_view name) const {
+	const SymbolTable& table = state->driver.table;
+	const SymbolId id = table.find(name);
+	if (id == noSymbol || table[id].vec || (table[id].kind != Kind::name && table[id].kind != Kind::constant))
+		return std::numeric_limits<double>::quiet_NaN();
+	return table[id];
+}
+
+/// Return the errors reported to date
+const std::vector<Diagnostic>& Calculator::diagnostics() const {
+	return state->diagnostics;
+}
+
+/// Discard the errors reported to date
+void Calculator::clear() {
+	state->diagnostics.clear();
+}
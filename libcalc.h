@@ -0,0 +1,69 @@
+/** @file libcalc.h
+ *
+ *	@brief	class Calculator
+ *
+ *	calc, embedded; the library's interface. Expressions are compiled once, and
+ *	evaluated as often as required, reading, and writing, host variables bound
+ *	by pointer.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef LIBCALC_H
+#define LIBCALC_H
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "diagnostic.h"
+
+/// Exported from libcalc.so; the rest of the library, built with hidden visibility, isn't
+#if defined(__GNUC__)
+#define CALC_API	__attribute__((visibility("default")))
+#else
+#define CALC_API
+#endif
+
+/** An embedded calculator
+ *
+ *	Each calculator has variables, functions and procedures of its own, and
+ *	may be used by one thread at a time. Expressions are any calc statements;
+ *	nothing is printed, and an expression's value is that of the last top
+ *	level expression, or assignment, that it evaluated.
+ *
+ *	Host variables are bound to names before the expressions that use them are
+ *	compiled; those expressions then read, and assign to, the host's double
+ *	directly. Evaluation neither allocates, nor copies bound variables, unless
+ *	vectors are involved, or errors reported.
+ *
+ *	Errors are collected as Diagnostic's, rather than written; lines are
+ *	relative to the expression's text. Runtime errors result in NaN.
+ */
+class CALC_API Calculator {
+public:
+	class Expression;					///< A compiled expression
+
+private:
+	struct State;
+
+	std::unique_ptr<State>	state;		///< The compiler, virtual machine and variables
+
+public:
+	Calculator();
+	~Calculator();
+
+	Calculator(const Calculator&) = delete;
+	Calculator& operator=(const Calculator&) = delete;
+
+	void jit(bool on);
+	bool bind(std::string_view name, double* value);
+	const Expression* compile(std::string_view text);
+	double evaluate(const Expression* expr);
+	double value(std::string_view name) const;
+
+	const std::vector<Diagnostic>& diagnostics() const;
+	void clear();
+};
+
+#endif
@@ -2,57 +2,244 @@
  *
  *	@brief	Math built-in implementation
  *
- *	Implementation of the math utilites; see errcheck(d,s).
+ *	Implementation of the math utilites. Domain, pole and range errors are
+ *	detected from each function's arguments and result, exactly as the C
+ *	library reports them via errno, but without reading or clearing errno;
+ *	so the batch kernels' loops are free of calls, other than to the library
+ *	function itself, and branches.
  *
  *	Created by Randy Merkel on 6/7/2013.
  *	Copyright (c) 2016 Randy Merkel. All rights reserved.
  */
 
-#include <cerrno>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <limits>
-#include <random>
 
 #include "math.h"
+#include "random.h"
+#include "simd.h"
 
-/// Check result of standard library call
-static double errcheck(double d) {
-	if (0 != errno) {
-		errno = 0;
-		return std::numeric_limits<double>::quiet_NaN();
-	}
+/************************************************************************************************
+ *	Error detection																				*
+ ************************************************************************************************/
+
+namespace {
+
+const double nan = std::numeric_limits<double>::quiet_NaN();
+const double huge = std::numeric_limits<double>::max();
+
+/// Is x neither infinite nor NaN?
+inline bool finite(double x)			{	return std::fabs(x) <= huge;	}
+
+/// Is x infinite?
+inline bool infinite(double x)			{	return std::fabs(x) > huge;		}
 
-	return d;
+/// Is x NaN?
+inline bool isNaN(double x)				{	return x != x;					}
+
+/// log(x), or log10(x), is r; domain error if x < 0, pole error if x is 0
+inline double logResult(double x, double r) {
+	return x <= 0 ? nan : r;
+}
+
+/// exp(x) is r; range error if it overflows, or underflows to 0
+inline double expResult(double x, double r) {
+	return finite(x) && (infinite(r) || r == 0) ? nan : r;
 }
 
-// Random numbers - should use <chrono> for the seed.
-static	std::default_random_engine generator (static_cast<double> (clock()));
-static	std::uniform_real_distribution<double> distribution(0,1);
+/// sqrt(x) is r; domain error if x < 0
+inline double sqrtResult(double x, double r) {
+	return x < 0 ? nan : r;
+}
+
+/// pow(x, y) is r; domain error if NaN from numbers, pole or range error if r is infinite, or 0
+/// from finite operands
+inline double powResult(double x, double y, double r) {
+	const bool domain = isNaN(r) && !isNaN(x) && !isNaN(y);
+	const bool range = finite(x) && finite(y) && (infinite(r) || (r == 0 && x != 0));
+	return domain || range ? nan : r;
+}
+
+/// Return r[i] = pow(x(i), y(i)), checked, for i in [0, n)
+template<typename X, typename Y>
+inline void pow(X x, Y y, double* r, size_t n) {
+	for (size_t i = 0; i < n; ++i)
+		r[i] = powResult(x(i), y(i), std::pow(x(i), y(i)));
+}
+
+}
+
+/************************************************************************************************
+ *	Scalar builtins																				*
+ ************************************************************************************************/
+
+// Random numbers; the current driver's generator
+
+/// Return x as a 64-bit seed, or stream index; its bits if it's not a whole number that fits
+static uint64_t toIndex(double x) {
+	if (x >= 0 && x < 0x1p64 && x == std::floor(x))
+		return static_cast<uint64_t>(x);
+
+	uint64_t b;
+	std::memcpy(&b, &x, sizeof b);
+	return b;
+}
 
 double Rand() {	// return psudo random value n the range 0-1
-	return distribution(generator);
+	return Random::current().uniform();
+}
+
+double Seed(double x) {
+	Random::current().seed(toIndex(x));
+	return x;
+}
+
+double Stream(double x) {
+	Random::current().stream(toIndex(x));
+	return x;
+}
+
+double Uniform(double x) {
+	return Random::current().uniform() * x;
 }
 
 double Log(double x) {
-	return errcheck(std::log(x));
+	return logResult(x, std::log(x));
 }
 
 double Log10(double x) {
-	return errcheck(std::log10(x));
+	return logResult(x, std::log10(x));
 }
 
 double Exp(double x) {
-	return errcheck(std::exp(x));
+	return expResult(x, std::exp(x));
 }
 
 double Sqrt(double x) {
-	return errcheck(std::sqrt(x));
+	return sqrtResult(x, std::sqrt(x));
 }
 
 double Pow(double x, double y) {
-	return errcheck(std::pow(x, y));
+	return powResult(x, y, std::pow(x, y));
 }
 
 double Integer(double x) {
-	return static_cast<double> (int(x));
+	return std::trunc(x);
+}
+
+bool ExactMod(int64_t x, int64_t y, int64_t& r) {
+	if (y == 0)
+		return false;
+	else if (y == 1 || y == -1) {
+		r = 0;
+		return true;
+	}
+
+	const int64_t q = x / y;
+	int64_t m = x % y;					// has x's sign; |m| < |y|
+	const uint64_t am = m < 0 ? 0 - uint64_t(m) : uint64_t(m);
+	const uint64_t ay = y < 0 ? 0 - uint64_t(y) : uint64_t(y);
+	if (am > ay - am || (am == ay - am && (q & 1)))	// round the quotient away from zero
+		m = m < 0 ? int64_t(uint64_t(m) + ay) : int64_t(uint64_t(m) - ay);
+
+	r = m;
+	return true;
+}
+
+bool ExactPow(int64_t x, int64_t y, int64_t& r) {
+	if (y < 0)
+		return false;
+
+	int64_t result = 1;
+	for (;;) {
+		if ((y & 1) && __builtin_mul_overflow(result, x, &result))
+			return false;
+		if ((y >>= 1) == 0)
+			break;
+		if (__builtin_mul_overflow(x, x, &x))
+			return false;
+	}
+
+	r = result;
+	return true;
+}
+
+double Sum(const double* v, size_t n) {
+	return simd().sum(v, n);
+}
+
+double Min(const double* v, size_t n) {
+	return simd().min(v, n);
+}
+
+double Max(const double* v, size_t n) {
+	return simd().max(v, n);
+}
+
+double Mean(const double* v, size_t n) {
+	return n ? simd().sum(v, n) / n : std::numeric_limits<double>::quiet_NaN();
+}
+
+double Len(const double*, size_t n) {
+	return static_cast<double> (n);
+}
+
+/************************************************************************************************
+ *	Batch kernels																				*
+ ************************************************************************************************/
+
+void Log(const double* x, double* r, size_t n) {
+	for (size_t i = 0; i < n; ++i)
+		r[i] = logResult(x[i], std::log(x[i]));
+}
+
+void Log10(const double* x, double* r, size_t n) {
+	for (size_t i = 0; i < n; ++i)
+		r[i] = logResult(x[i], std::log10(x[i]));
+}
+
+void Exp(const double* x, double* r, size_t n) {
+	for (size_t i = 0; i < n; ++i)
+		r[i] = expResult(x[i], std::exp(x[i]));
+}
+
+void Sqrt(const double* x, double* r, size_t n) {
+	for (size_t i = 0; i < n; ++i)
+		r[i] = sqrtResult(x[i], std::sqrt(x[i]));
+}
+
+void Uniform(const double* x, double* r, size_t n) {
+	double u[256];							// r may be x
+
+	for (size_t i = 0; i < n; i += 256) {
+		const size_t m = n - i < 256 ? n - i : 256;
+		Random::current().fill(u, m);
+		for (size_t j = 0; j < m; ++j)
+			r[i + j] = u[j] * x[i + j];
+	}
+}
+
+void Pow(const double* x, const double* y, double* r, size_t n) {
+	pow([=](size_t i) { return x[i]; }, [=](size_t i) { return y[i]; }, r, n);
+}
+
+void Pow(const double* x, double y, double* r, size_t n) {
+	pow([=](size_t i) { return x[i]; }, [=](size_t) { return y; }, r, n);
+}
+
+void Pow(double x, const double* y, double* r, size_t n) {
+	pow([=](size_t) { return x; }, [=](size_t i) { return y[i]; }, r, n);
+}
+
+Batch batch(double (*func)(double)) {
+	typedef double (*Scalar)(double);
+
+	if (func == Scalar(Log))			return Log;
+	else if (func == Scalar(Log10))		return Log10;
+	else if (func == Scalar(Exp))		return Exp;
+	else if (func == Scalar(Sqrt))		return Sqrt;
+	else if (func == Scalar(Uniform))	return Uniform;
+	else								return nullptr;
 }
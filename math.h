@@ -3,7 +3,8 @@
  *	@brief	Math built-ins
  *
  *	Built in math functiions, most with error checking: returns NaN if the 
- *	underlying library function returns EDOM or ERANGE.
+ *	underlying library function would report EDOM or ERANGE. Batch versions,
+ *	with identical results, compute r[0..n) from x[0..n); r may be x.
  *
  *	Created by Randy Merkel on 6/7/2013.
  *	Copyright (c) 2016 Randy Merkel. All rights reserved.
@@ -12,9 +13,21 @@
 #ifndef MATH_H
 #define MATH_H
 
+#include <cstddef>
+#include <cstdint>
+
 /// return psudo random value n the range 0-1
 double Rand();
 
+/// Restart the random numbers with seed x; returns x
+double Seed(double x);
+
+/// Restart the random numbers at the beginning of independent stream x; returns x
+double Stream(double x);
+
+/// Returns a psudo random value in the range [0, x)
+double Uniform(double x);
+
 /// Returns the natural logarithm of x, or NaN in case of error
 double Log(double x);
 
@@ -30,7 +43,96 @@ double Sqrt(double);
 /// Returns x based to the y power, or Nan in case of error
 double Pow(double x, double y);
 
-///  Returns x as an integer, with out rounding
+///  Returns x as an integer, with out rounding; exact for any finite double
 double Integer(double x);
 
+/// Returns true if x is neither zero, nor NaN; the truth of a condition
+inline bool Truth(double x)	{	return x != 0 && x == x;	}
+
+/************************************************************************************************
+ *	Exact integer arithmetic																	*
+ *																								*
+ *	Each returns true, setting r, if the result is an integer that fits in an int64_t, and		*
+ *	false, leaving r unchanged, if it must be computed as a double instead.						*
+ ************************************************************************************************/
+
+/// Sets r to x, if x is an integer in the range of an int64_t
+inline bool Exact(double x, int64_t& r) {
+	if (!(x >= -9223372036854775808.0 && x < 9223372036854775808.0) || x != static_cast<double>(static_cast<int64_t>(x)))
+		return false;
+	r = static_cast<int64_t>(x);
+	return true;
+}
+
+/// Sets r to x + y
+inline bool ExactAdd(int64_t x, int64_t y, int64_t& r)	{	return !__builtin_add_overflow(x, y, &r);	}
+
+/// Sets r to x - y
+inline bool ExactSub(int64_t x, int64_t y, int64_t& r)	{	return !__builtin_sub_overflow(x, y, &r);	}
+
+/// Sets r to x * y
+inline bool ExactMul(int64_t x, int64_t y, int64_t& r)	{	return !__builtin_mul_overflow(x, y, &r);	}
+
+/// Sets r to x / y, if y divides x
+inline bool ExactDiv(int64_t x, int64_t y, int64_t& r) {
+	if (y == 0 || (y == -1 && x == INT64_MIN) || x % y != 0)
+		return false;
+	r = x / y;
+	return true;
+}
+
+/// Sets r to std::remainder(x, y); x - n * y, where n is x / y rounded to the nearest, even, integer
+bool ExactMod(int64_t x, int64_t y, int64_t& r);
+
+/// Sets r to x to the y power, for y >= 0
+bool ExactPow(int64_t x, int64_t y, int64_t& r);
+
+/// Returns true if x isn't zero; the truth of a condition
+inline bool Truth(int64_t x)	{	return x != 0;	}
+
+/// Returns the sum of v[0..n)
+double Sum(const double* v, size_t n);
+
+/// Returns the minimum of v[0..n), or NaN if n is zero
+double Min(const double* v, size_t n);
+
+/// Returns the maximum of v[0..n), or NaN if n is zero
+double Max(const double* v, size_t n);
+
+/// Returns the arithmetic mean of v[0..n), or NaN if n is zero
+double Mean(const double* v, size_t n);
+
+/// Returns n, the length of v
+double Len(const double* v, size_t n);
+
+/// A batch version of a builtin1; r[i] = f(x[i]) for i in [0, n)
+typedef void (*Batch)(const double* x, double* r, size_t n);
+
+/// Sets r[0..n) to the natural logarithms of x[0..n), or NaN in case of error
+void Log(const double* x, double* r, size_t n);
+
+/// Sets r[0..n) to the common logarithms of x[0..n), or NaN in case of error
+void Log10(const double* x, double* r, size_t n);
+
+/// Sets r[0..n) to the Exponential values of x[0..n), or NaN in case of error
+void Exp(const double* x, double* r, size_t n);
+
+/// Sets r[0..n) to the Square-Roots of x[0..n), or NaN in case of error
+void Sqrt(const double* x, double* r, size_t n);
+
+/// Sets r[0..n) to psudo random values in the ranges [0, x[i]); generated in bulk
+void Uniform(const double* x, double* r, size_t n);
+
+/// Sets r[0..n) to x[i] raised to the y[i] power, or NaN in case of error
+void Pow(const double* x, const double* y, double* r, size_t n);
+
+/// Sets r[0..n) to x[i] raised to the y power, or NaN in case of error
+void Pow(const double* x, double y, double* r, size_t n);
+
+/// Sets r[0..n) to x raised to the y[i] power, or NaN in case of error
+void Pow(double x, const double* y, double* r, size_t n);
+
+/// Returns the batch version of func, or null if there isn't one
+Batch batch(double (*func)(double));
+
 #endif
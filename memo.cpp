@@ -0,0 +1,22 @@
+/** @file memo.cpp
+ *
+ *	@brief	class Memo implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include "memo.h"
+
+// public:
+
+/// Construct an empty cache of at least n entries
+Memo::Memo(size_t n) : capacity{1}, hits{0}, misses{0} {
+	while (capacity < n)
+		capacity <<= 1;
+}
+
+/// Forget every result, and reset the counters
+void Memo::clear() {
+	entries.clear();
+	hits = misses = 0;
+}
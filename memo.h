@@ -0,0 +1,93 @@
+/** @file memo.h
+ *
+ *	@brief	class Memo
+ *
+ *	A memoization cache for calls to pure builtins.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "symbol.h"
+
+/** A bounded cache of builtin results, keyed by builtin and argument bits
+ *
+ *	Direct mapped; a miss simply replaces whatever occupies the key's entry, so
+ *	there's no bookkeeping beyond the entry itself. Arguments are compared
+ *	bitwise, so -0 and 0 are different keys, and a NaN argument is cached
+ *	like any other. Only builtins marked pure may be memoized, as the cached
+ *	result is returned in place of calling the builtin.
+ *
+ *	Entries are allocated on first use.
+ */
+class Memo {
+	/// A cached result
+	struct Entry {
+		uint64_t	x;					///< First argument's bits
+		uint64_t	y;					///< Second argument's bits, or 0
+		SymbolId	id;					///< The builtin, or noSymbol if empty
+		double		value;				///< The result
+	};
+
+	std::vector<Entry>	entries;		///< The cache
+	size_t				capacity;		///< Entries; a power of two
+
+	/// Return the bits of d
+	static uint64_t bits(double d)		{	uint64_t b; std::memcpy(&b, &d, sizeof b); return b;	}
+
+	/// Return the entry for id(x, y); allocate the cache if required
+	Entry& entry(SymbolId id, uint64_t x, uint64_t y) {
+		if (entries.empty())
+			entries.assign(capacity, Entry { 0, 0, noSymbol, 0 });
+
+		uint64_t h = (x ^ (y * 0xc2b2ae3d27d4eb4full) ^ id) * 0x9e3779b97f4a7c15ull;
+		return entries[(h ^ h >> 32) & (capacity - 1)];
+	}
+
+public:
+	static const size_t defaultCapacity = 4096;	///< Default number of entries
+
+	size_t				hits;			///< Calls answered by the cache
+	size_t				misses;			///< Calls made, and cached
+
+	explicit Memo(size_t n = defaultCapacity);
+
+	void clear();
+
+	/// Return func(x), as builtin id
+	double operator()(SymbolId id, double (*func)(double), double x) {
+		const uint64_t xb = bits(x);
+		Entry& e = entry(id, xb, 0);
+		if (e.id == id && e.x == xb) {
+			++hits;
+			return e.value;
+		}
+
+		++misses;
+		e = Entry { xb, 0, id, func(x) };
+		return e.value;
+	}
+
+	/// Return func(x, y), as builtin id
+	double operator()(SymbolId id, double (*func)(double, double), double x, double y) {
+		const uint64_t xb = bits(x), yb = bits(y);
+		Entry& e = entry(id, xb, yb);
+		if (e.id == id && e.x == xb && e.y == yb) {
+			++hits;
+			return e.value;
+		}
+
+		++misses;
+		e = Entry { xb, yb, id, func(x, y) };
+		return e.value;
+	}
+};
+
+#endif
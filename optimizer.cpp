@@ -0,0 +1,267 @@
+/** @file optimizer.cpp
+ *
+ *	@brief	class Optimizer implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include "optimizer.h"
+#include "math.h"
+
+/// Set r to x op y, evaluated exactly, as the virtual machine would; false if it can't be
+static bool exactly(Op op, int64_t x, int64_t y, int64_t& r) {
+	switch(op) {
+	case Op::add:	return ExactAdd(x, y, r);
+	case Op::sub:	return ExactSub(x, y, r);
+	case Op::mul:	return ExactMul(x, y, r);
+	case Op::div:	return ExactDiv(x, y, r);
+	case Op::mod:	return ExactMod(x, y, r);
+	case Op::pow:	return ExactPow(x, y, r);
+	case Op::lt:	r = x < y;	return true;
+	case Op::le:	r = x <= y;	return true;
+	case Op::gt:	r = x > y;	return true;
+	case Op::ge:	r = x >= y;	return true;
+	case Op::eq:	r = x == y;	return true;
+	case Op::ne:	r = x != y;	return true;
+	case Op::land:	r = Truth(x) && Truth(y);	return true;
+	case Op::lor:	r = Truth(x) || Truth(y);	return true;
+	default:		return false;
+	}
+}
+
+// private:
+
+/// Does the tree at r assign to a variable?
+bool Optimizer::assigns(const Tree& tree, NodeRef r) {
+	if (nilNode == r)
+		return false;
+
+	const Node& n = tree[r];
+	switch(n.op) {
+	case Op::assign:
+	case Op::setarg:
+	case Op::call:		return true;	// a function may assign to anything
+	case Op::number:
+	case Op::integer:
+	case Op::variable:
+	case Op::arg:
+	case Op::call0:
+	case Op::file:		return false;
+	case Op::range:		return assigns(tree, n.left) || assigns(tree, n.right) || assigns(tree, n.step);
+	default:			return assigns(tree, n.left) || assigns(tree, n.right);
+	}
+}
+
+/** Add n to the tree, or if it's shared, return its identical twin
+ *
+ *	@param	n		The node; its operands have already been added
+ *	@param	p		Is n, and are its operands, free of side effects?
+ *
+ *	@return	n's reference
+ */
+NodeRef Optimizer::add(const Node& n, bool p) {
+	Key key { n.op, n.left, n.right, 0 };
+	switch(n.op) {
+	case Op::number:	std::memcpy(&key.payload, &n.value, sizeof n.value);	break;
+	case Op::integer:	std::memcpy(&key.payload, &n.integer, sizeof n.integer);	break;
+	case Op::range:		key.payload = n.step;	break;
+	case Op::vector:
+	case Op::list:
+	case Op::neg:
+	case Op::add:
+	case Op::sub:
+	case Op::mul:
+	case Op::div:
+	case Op::mod:
+	case Op::pow:
+	case Op::lt:
+	case Op::le:
+	case Op::gt:
+	case Op::ge:
+	case Op::eq:
+	case Op::ne:
+	case Op::land:
+	case Op::lor:
+	case Op::lnot:		break;
+	default:			key.payload = n.sym;	break;
+	}
+
+	if (share && p) {
+		const auto i = nodes->find(key);
+		if (i != nodes->end())
+			return i->second;
+	}
+
+	const NodeRef r = tree->add(n);
+	pure.resize(tree->size());
+	pure[r] = p;
+	if (share && p)
+		nodes->emplace(key, r);
+
+	return r;
+}
+
+/// Fold and hash-cons the tree at r, returning its replacement
+NodeRef Optimizer::fold(NodeRef r) {
+	if (nilNode == r)
+		return nilNode;
+
+	const Node n = (*tree)[r];			// copy; adding nodes invalidates references
+	NodeRef left = nilNode, right = nilNode;
+
+	switch(n.op) {
+	case Op::number:
+	case Op::integer:
+		return add(n, true);
+
+	case Op::variable: {
+		const SymValue& s = table[n.sym];
+		if (s.kind == Kind::constant && !s.vec)
+			return number(s.u.value);
+		return add(n, true);
+	}
+
+	case Op::arg:
+		return add(n, true);
+
+	case Op::assign:
+	case Op::setarg:
+		return add(Node(n.sym, n.op, fold(n.left)), false);
+
+	case Op::call:
+		return add(Node(n.sym, Op::call, fold(n.left)), false);
+
+	case Op::neg:
+		left = fold(n.left);
+		if (exact(left) && (*tree)[left].integer != INT64_MIN)
+			return integer(-(*tree)[left].integer);
+		else if (constant(left))
+			return number(-value(left));
+		return add(Node(Op::neg, left), clean(left));
+
+	case Op::lnot:
+		left = fold(n.left);
+		if (constant(left))
+			return integer(!Truth(value(left)));
+		return add(Node(Op::lnot, left), clean(left));
+
+	case Op::add:
+	case Op::sub:
+	case Op::mul:
+	case Op::div:
+	case Op::mod:
+	case Op::pow:
+	case Op::lt:
+	case Op::le:
+	case Op::gt:
+	case Op::ge:
+	case Op::eq:
+	case Op::ne:
+	case Op::land:
+	case Op::lor:
+		left = fold(n.left);
+		right = fold(n.right);
+		if (constant(left) && constant(right)) {
+			int64_t i;
+			if (exact(left) && exact(right) && exactly(n.op, (*tree)[left].integer, (*tree)[right].integer, i))
+				return integer(i);
+
+			const double x = value(left), y = value(right);
+			switch(n.op) {
+			case Op::add:	return number(x + y);
+			case Op::sub:	return number(x - y);
+			case Op::mul:	return number(x * y);
+			case Op::pow:	return number(Pow(x, y));
+			case Op::lt:	return integer(x < y);
+			case Op::le:	return integer(x <= y);
+			case Op::gt:	return integer(x > y);
+			case Op::ge:	return integer(x >= y);
+			case Op::eq:	return integer(x == y);
+			case Op::ne:	return integer(x != y);
+			case Op::land:	return integer(Truth(x) && Truth(y));
+			case Op::lor:	return integer(Truth(x) || Truth(y));
+			case Op::div:	if (y) return number(x / y);				break;
+			case Op::mod:	if (y) return number(std::remainder(x, y));	break;
+			default:		break;
+			}
+		}
+		return add(Node(n.op, left, right), clean(left) && clean(right));
+
+	case Op::call0:
+		return add(n, table[n.sym].pure);
+
+	case Op::call1:
+		left = fold(n.left);
+		if (table[n.sym].pure && constant(left)) {
+			const double x = table[n.sym].u.func1(value(left));
+			int64_t i;
+			if (table[n.sym].u.func1 == Integer && exact(left))
+				return left;
+			else if (table[n.sym].u.func1 == Integer && Exact(x, i))
+				return integer(i);
+			return number(x);
+		}
+		return add(Node(n.sym, Op::call1, left), table[n.sym].pure && clean(left));
+
+	case Op::call2:
+		left = fold(n.left);
+		right = fold(n.right);
+		if (table[n.sym].pure && constant(left) && constant(right))
+			return number(table[n.sym].u.func2(value(left), value(right)));
+		return add(Node(n.sym, Op::call2, left, right), table[n.sym].pure && clean(left) && clean(right));
+
+	case Op::callv:
+		left = fold(n.left);
+		if (table[n.sym].pure && constant(left)) {
+			const double x = value(left);
+			return number(table[n.sym].u.funcv(&x, 1));
+		}
+		return add(Node(n.sym, Op::callv, left), table[n.sym].pure && clean(left));
+
+	case Op::vector:
+	case Op::list:
+		left = fold(n.left);
+		right = fold(n.right);
+		return add(Node(n.op, left, right), clean(left) && clean(right));
+
+	case Op::range: {
+		left = fold(n.left);
+		right = fold(n.right);
+		Node m(Op::range, left, right);
+		m.step = fold(n.step);
+		return add(m, clean(left) && clean(right) && clean(m.step));
+	}
+
+	case Op::file:
+		return add(n, false);
+	}
+
+	return r;
+}
+
+// public:
+
+/** Optimize a statement's tree
+ *
+ *	@param	t		The tree; optimized nodes are added to it
+ *	@param	root	The statement's root
+ *
+ *	@return	The optimized statement's root
+ */
+NodeRef Optimizer::operator()(Tree& t, NodeRef root) {
+	tree = &t;
+	nodes.emplace(0, Hash(), std::equal_to<Key>(), Nodes::allocator_type(arena));
+	pure.assign(t.size(), false);
+
+	NodeRef e = root;					// assignments to the statement's value are fine
+	while (nilNode != e && t[e].op == Op::assign)
+		e = t[e].left;
+	share = !assigns(t, e);
+
+	root = fold(root);
+	nodes.reset();						// before the arena is
+	return root;
+}
@@ -0,0 +1,103 @@
+/** @file optimizer.h
+ *
+ *	@brief	class Optimizer
+ *
+ *	Constant folding, and common sub-expression elimination, of parse trees.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+#include "ast.h"
+#include "symbol.h"
+
+/** Parse tree optimizer
+ *
+ *	Folds operations on literals, the constants (pi, e...), and calls to pure
+ *	builtins, with literal arguments, into literals. Division, or remainder, by
+ *	zero is left for the virtual machine to report. Integer literals are folded
+ *	exactly as the virtual machine would evaluate them.
+ *
+ *	Identical side effect free sub-trees are hash-consed into a single node,
+ *	turning the tree into a DAG that Code evaluates each shared node of once.
+ *	Statements that assign to variables mid-expression aren't hash-consed, as
+ *	the same sub-tree may then have different values.
+ *
+ *	The table of shared nodes is allocated from the parser's per statement
+ *	arena, and discarded after each tree is optimized.
+ */
+class Optimizer {
+	/// A node's identity; its operation, operands and payload
+	struct Key {
+		Op			op;					///< Operation
+		NodeRef		left;				///< Left operand
+		NodeRef		right;				///< Right operand
+		uint64_t	payload;			///< Value, symbol or step
+
+		/// Are the nodes identical?
+		bool operator==(const Key& k) const {
+			return op == k.op && left == k.left && right == k.right && payload == k.payload;
+		}
+	};
+
+	/// Hash a Key
+	struct Hash {
+		size_t operator()(const Key& k) const {
+			uint64_t h = (uint64_t(k.op) << 56) ^ (uint64_t(k.left) << 28) ^ k.right ^ k.payload;
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdULL;
+			return size_t(h ^ (h >> 33));
+		}
+	};
+
+	/// Shared nodes, by identity
+	typedef std::unordered_map<Key, NodeRef, Hash, std::equal_to<Key>,
+		ArenaAllocator<std::pair<const Key, NodeRef>>> Nodes;
+
+	const SymbolTable&		table;		///< The symbol table; constants and builtins
+	Arena&					arena;		///< Storage for nodes
+	Tree*					tree;		///< The tree being optimized
+	std::optional<Nodes>	nodes;		///< Shared nodes, while optimizing
+	std::vector<bool>		pure;		///< By NodeRef; free of side effects?
+	bool					share;		///< Hash-cons the statement?
+
+	static bool assigns(const Tree& tree, NodeRef r);
+	NodeRef add(const Node& n, bool pure);
+
+	/// Add the literal value
+	NodeRef number(double value)		{	return add(Node(value), true);	}
+
+	/// Add the integer literal value
+	NodeRef integer(int64_t value)		{	return add(Node(value), true);	}
+
+	/// Is r a literal?
+	bool constant(NodeRef r) const		{	return (*tree)[r].op == Op::number || exact(r);	}
+
+	/// Is r an integer literal?
+	bool exact(NodeRef r) const			{	return (*tree)[r].op == Op::integer;	}
+
+	/// Is r nil, or free of side effects?
+	bool clean(NodeRef r) const			{	return nilNode == r || pure[r];		}
+
+	/// Return literal r's value
+	double value(NodeRef r) const		{	return exact(r) ? double((*tree)[r].integer) : (*tree)[r].value;	}
+
+	NodeRef fold(NodeRef r);
+
+public:
+	/// Construct an optimizer for trees that refer to symbols in t, allocating from a
+	Optimizer(const SymbolTable& t, Arena& a) : table{t}, arena{a}, tree{nullptr}, share{false} {}
+
+	NodeRef operator()(Tree& tree, NodeRef root);
+};
+
+#endif
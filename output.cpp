@@ -0,0 +1,210 @@
+/**	@file	output.cpp
+ *
+ *	@brief	Output implementation.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <unistd.h>
+
+#include "output.h"
+
+/// Write len bytes at s to fd, retrying interrupted and partial writes
+static void writeAll(int fd, const char* s, size_t len) {
+	while (len) {
+		const ssize_t w = ::write(fd, s, len);
+		if (w < 0 && EINTR == errno)
+			continue;
+		else if (w <= 0)
+			return;						// nowhere to report it; drop the output
+
+		s += w;
+		len -= w;
+	}
+}
+
+/************************************************************************************************
+ *	Transcript																					*
+ ************************************************************************************************/
+
+/// Append the len bytes at s, destined for fd
+void Transcript::append(int fd, const char* s, size_t len) {
+	if (chunks.empty() || chunks.back().first != fd)
+		chunks.emplace_back(fd, std::string());
+	chunks.back().second.append(s, len);
+}
+
+/// Append the captured output, whatever its destination, to s, and forget it
+void Transcript::drain(std::string& s) {
+	for (const auto& c : chunks)
+		s += c.second;
+	chunks.clear();
+}
+
+/// Write the captured output to the file descriptors it was destined for
+void Transcript::replay() const {
+	for (const auto& c : chunks)
+		writeAll(c.first, c.second.data(), c.second.size());
+}
+
+/************************************************************************************************
+ *	Output																						*
+ ************************************************************************************************/
+
+/// A thread writing full buffers, one at a time
+struct Output::Writer {
+	std::mutex				mutex;		///< Guards the rest
+	std::condition_variable	changed;	///< busy or quit changed
+	std::vector<char>		data;		///< The buffer being written
+	size_t					len = 0;	///< Bytes to write from data
+	bool					busy = false;	///< Writing data?
+	bool					quit = false;	///< Stop, once data is written?
+	std::thread				thread;		///< Writes data to fd
+
+	/// Wait until data has been written
+	void wait(std::unique_lock<std::mutex>& lock) {
+		changed.wait(lock, [this]() { return !busy; });
+	}
+
+	/// Write data to fd when busy, until quit
+	void run(int fd) {
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			changed.wait(lock, [this]() { return busy || quit; });
+			if (!busy)
+				return;
+
+			lock.unlock();
+			writeAll(fd, data.data(), len);
+			lock.lock();
+			busy = false;
+			changed.notify_all();
+		}
+	}
+};
+
+// private:
+
+/// Write len bytes at s to the file descriptor, or transcript
+void Output::write(const char* s, size_t len) {
+	if (transcript)
+		transcript->append(fd, s, len);
+	else
+		writeAll(fd, s, len);
+}
+
+/// Write the buffer, or in the background, hand it to the writer
+void Output::spill() {
+	if (!writer)
+		return flush();
+
+	std::unique_lock<std::mutex> lock(writer->mutex);
+	writer->wait(lock);
+	writer->data.swap(buf);
+	writer->len = n;
+	writer->busy = true;
+	writer->changed.notify_all();
+	lock.unlock();
+
+	buf.resize(size);
+	n = 0;
+}
+
+// public:
+
+/** Construct an output sink
+ *
+ *	@param	fd	The file descriptor, which remains owned by the caller
+ *	@param	t	If not null, capture output here, rather than writing it to fd
+ */
+Output::Output(int fd, Transcript* t)
+	: fd{fd}, transcript{t}, buf(size), n{0}, prec{defaultPrecision} {
+}
+
+/// Destructor; flushes any buffered output
+Output::~Output() {
+	background(false);
+}
+
+/// Write s
+Output& Output::operator<<(std::string_view s) {
+	if (s.size() > buf.size()) {		// too large to buffer
+		flush();
+		write(s.data(), s.size());
+
+	} else {
+		reserve(s.size());
+		std::memcpy(buf.data() + n, s.data(), s.size());
+		n += s.size();
+	}
+
+	return *this;
+}
+
+/// Write u in decimal
+Output& Output::operator<<(unsigned u) {
+	reserve(16);
+	n = std::to_chars(buf.data() + n, buf.data() + buf.size(), u).ptr - buf.data();
+	return *this;
+}
+
+/// Write i, exactly; regardless of precision()
+Output& Output::operator<<(int64_t i) {
+	reserve(24);
+	n = std::to_chars(buf.data() + n, buf.data() + buf.size(), i).ptr - buf.data();
+	return *this;
+}
+
+/// Write v, formatted per precision()
+Output& Output::operator<<(double v) {
+	reserve(32);						// enough for any double in either format
+	char* const first = buf.data() + n;
+	char* const last = buf.data() + buf.size();
+	const std::to_chars_result r = prec > 0
+		? std::to_chars(first, last, v, std::chars_format::general, prec)
+		: std::to_chars(first, last, v);
+
+	if (std::errc() == r.ec)
+		n = r.ptr - buf.data();
+	return *this;
+}
+
+/// Write the buffer, and wait for anything written in the background
+void Output::flush() {
+	if (writer) {
+		std::unique_lock<std::mutex> lock(writer->mutex);
+		writer->wait(lock);
+	}
+
+	if (n)
+		write(buf.data(), n);
+	n = 0;
+}
+
+/** Write full buffers on a thread of their own, or not
+ *
+ *	Output captured in a transcript is always written directly.
+ */
+void Output::background(bool on) {
+	flush();
+	if (on && !writer && !transcript) {
+		writer.reset(new Writer);
+		writer->thread = std::thread(&Writer::run, writer.get(), fd);
+
+	} else if (!on && writer) {
+		{
+			std::lock_guard<std::mutex> lock(writer->mutex);
+			writer->quit = true;
+			writer->changed.notify_all();
+		}
+		writer->thread.join();
+		writer.reset();
+	}
+}
@@ -0,0 +1,96 @@
+/**	@file	output.h
+ *
+ *	@brief	class Output and Transcript
+ *
+ *	A buffered output sink for results and diagnostics, and a transcript for
+ *	capturing them to be written later.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/** Output captured to be written later
+ *
+ *	Writes to any number of file descriptors are kept in the order made, so that
+ *	results and diagnostics interleave as they would have written directly.
+ */
+class Transcript {
+	std::vector<std::pair<int, std::string>>	chunks;		///< (fd, bytes), in order
+
+public:
+	void append(int fd, const char* s, size_t len);
+	void drain(std::string& s);
+	void replay() const;
+};
+
+/** A buffered file descriptor
+ *
+ *	Writes collect in a large buffer that's written when full, or on flush(),
+ *	either to the file descriptor, or if given, to a transcript.
+ *	Numbers are formatted with std::to_chars; either shortest round trip
+ *	(precision 0), or as printf's %.*g would, to precision significant digits.
+ *	Integers are always written in full.
+ *
+ *	In the background, full buffers are handed to a thread of their own to be
+ *	written, while the next fills; flush() waits for them to be written.
+ */
+class Output {
+	struct Writer;
+
+	int					fd;				///< The file descriptor
+	Transcript*			transcript;		///< Capture output here, if not null
+	std::vector<char>	buf;			///< The output buffer
+	size_t				n;				///< Bytes used in buf
+	int					prec;			///< Significant digits, or 0 for shortest
+	std::unique_ptr<Writer>	writer;		///< Writes full buffers, if in the background
+
+	void write(const char* s, size_t len);
+	void spill();
+
+	/// Make room for len bytes in the buffer
+	void reserve(size_t len)			{	if (buf.size() - n < len) spill();	}
+
+public:
+	static const size_t size = 64 * 1024;	///< Buffer size
+	static const int defaultPrecision = 6;	///< Significant digits, as std::cout
+	static const int maxPrecision = 17;		///< Enough to round trip any double
+
+	explicit Output(int fd, Transcript* t = nullptr);
+	~Output();
+
+	Output(const Output&) = delete;
+	Output& operator=(const Output&) = delete;
+
+	/// Return the precision; significant digits, or 0 for shortest round trip
+	int precision() const				{	return prec;		}
+
+	/// Set the precision to p significant digits, or shortest round trip if 0
+	void precision(int p)				{	prec = p < 0 ? 0 : p > maxPrecision ? maxPrecision : p;	}
+
+	void background(bool on);
+
+	/// Is the buffer empty?
+	bool empty() const					{	return 0 == n;		}
+
+	/// Write ch
+	Output& operator<<(char ch)			{	reserve(1); buf[n++] = ch; return *this;	}
+
+	Output& operator<<(std::string_view s);
+	Output& operator<<(unsigned u);
+	Output& operator<<(int64_t i);
+	Output& operator<<(double v);
+
+	void flush();
+};
+
+#endif
@@ -10,146 +10,270 @@
  *	Copyright (c) 2016 Randy Merkel. All rights reserved.
  */
 
-#include <iostream>
-#include <cmath>
+#include <vector>
 
 #include "parser.h"
 #include "driver.h"
-#include "math.h"
 #include "symbol.h"
 
+// private:
+
+/// Report an error, returning a NaN literal in its place
+NodeRef Parser::error(const std::string& s) {
+	return tree.add(Node(driver.error(s)));
+}
+
+/// Report an error, returning a NaN literal in its place
+NodeRef Parser::error(const std::string& s, std::string_view t) {
+	return tree.add(Node(driver.error(s, t)));
+}
+
+/// Report an error at t, rather than the current token, returning a NaN literal in its place
+NodeRef Parser::error(const std::string& s, const Token& t) {
+	return tree.add(Node(driver.report({ driver.stage, t.line, t.column, s })));
+}
+
 /** Handle primary expressions
  *
  *	@param get get a new token if true
  *
- *	@return primary expression value
+ *	@return primary expression tree
  */
-double Parser::prim(bool get) {
+NodeRef Parser::prim(bool get) {
 	if (get)
 		ts.get();						// read next token
 
 	switch(ts.current().kind) {
-	case Kind::number: {				// floating-pont constant
-		double v = ts.current().number_value;
+	case Kind::number: {				// floating-pont, or integer, constant
+		const Token& t = ts.current();
+		const Node n = t.exact ? Node(t.integer_value) : Node(t.number_value);
 		ts.get();
-		return v;
+		return tree.add(n);
 	}
 
 	case Kind::name: {					// identifier
-		const std::string name = ts.current().string_value;
-		SymValue &v = table[name];
+		const SymbolId sym = ts.current().sym;
 
 		if (ts.get().kind == Kind::assign) {
-			if (v.kind == Kind::constant)
-				return driver.error("can not modify constant variable", name);
-			v = expr(true);
+			if (table[sym].kind == Kind::constant)
+				return error("can not modify constant variable", table.name(sym));
+			return tree.add(Node(sym, Op::assign, expr(true)));
+		}
 
-		} else if (v.kind == Kind::undefined)
-			return driver.error("undefined variable", name);
+		return tree.add(Node(sym, Op::variable));
+	}
 
-		return v;
+	case Kind::arg: {					// $n, or $n = expression
+		const Token t = ts.current();	// report errors at $n, not after it
+		const double n = t.number_value;
+		const bool assign = ts.get().kind == Kind::assign;
+		NodeRef e = assign ? expr(true) : nilNode;
+
+		if (noSymbol == defining)
+			return error("argument outside of a function or procedure", t);
+		else if (n < 1 || n > 0xffff)
+			return error("bad argument number", t);
+		return tree.add(Node(SymbolId(n), assign ? Op::setarg : Op::arg, e));
 	}
 
+	case Kind::function:				// function ( expression_list )
+		return call();
+
+	case Kind::procedure:
+		call();
+		return error("procedure used in an expression");
+
 	case Kind::minus:					// unary minus
-		return -prim(true);
+		return tree.add(Node(Op::neg, prim(true)));
+
+	case Kind::lnot:					// logical not
+		return tree.add(Node(Op::lnot, prim(true)));
 
 	case Kind::plus:					// unary plus
 		return prim(true);
 
 	case Kind::builtin: {				// func ()
-		SymValue& v = table[ts.current().string_value];
+		const SymbolId sym = ts.current().sym;
 		if (ts.get().kind != Kind::lp)
-		 	return driver.error("'(' expected");
+		 	return error("'(' expected");
 		else if (ts.get().kind != Kind::rp)
-			return driver.error("')' expected");
+			return error("')' expected");
 		else {
 			ts.get();					// eat ')'
-			return v.u.func();
+			return tree.add(Node(sym, Op::call0));
 		}
 	}
 			
 	case Kind::builtin1: {				// func ( expression )
-		std::string name = ts.current().string_value;
+		const SymbolId sym = ts.current().sym;
 		if (ts.get().kind != Kind::lp)
-			return driver.error("'(' expected");
+			return error("'(' expected");
 
 		else {
-			SymValue& v = table[name];
-			double e = expr(true);
+			NodeRef e = expr(true);
 				
 			if (ts.current().kind != Kind::rp)
-				return driver.error("')' expected");
+				return error("')' expected");
 				
 			ts.get();					// eat ')'
-			return v.u.func1(e);
+			return tree.add(Node(sym, Op::call1, e));
 		}
 	}
 			
 	case Kind::builtin2: {				// func ( expression, expression )
-		std::string name = ts.current().string_value;
+		const SymbolId sym = ts.current().sym;
 		if (ts.get().kind == Kind::lp) {
-			SymValue& v = table[name];
-
-			double e1 = expr(true);
+			NodeRef e1 = expr(true);
 			if (ts.current().kind != Kind::comma)
-				return driver.error("',' expected");
+				return error("',' expected");
 
-			double e2 = expr(true);
+			NodeRef e2 = expr(true);
 			if (ts.current().kind != Kind::rp)
-				return driver.error("')' expected");
+				return error("')' expected");
 				
 			ts.get();				// eat ')'
-			return v.u.func2(e1, e2);
+			return tree.add(Node(sym, Op::call2, e1, e2));
 
 		} else
-			return driver.error("'(' expected");
+			return error("'(' expected");
+	}
+
+	case Kind::builtinv: {				// func ( expression )
+		const SymbolId sym = ts.current().sym;
+		if (ts.get().kind != Kind::lp)
+			return error("'(' expected");
+
+		NodeRef e = expr(true);
+
+		if (ts.current().kind != Kind::rp)
+			return error("')' expected");
+
+		ts.get();						// eat ')'
+		return tree.add(Node(sym, Op::callv, e));
+	}
+
+	case Kind::load: {					// load ( string )
+		if (ts.get().kind != Kind::lp)
+			return error("'(' expected");
+		else if (ts.get().kind != Kind::string)
+			return error("file name expected");
+
+		Node n(Op::file, nilNode);
+		n.str = tree.add(ts.current().text);
+		if (ts.get().kind != Kind::rp)
+			return error("')' expected");
+
+		ts.get();						// eat ')'
+		return tree.add(n);
 	}
 
+	case Kind::lb:						// [ expression ... ]
+		return vector();
+
 	case Kind::lp: {					// ( expression )
 		auto e = expr(true);
 		if (ts.current().kind != Kind::rp)
-			return driver.error("')' expected");
+			return error("')' expected");
 
 		ts.get();						// eat ')'
 		return e;
 	}
 
 	default:
-		return driver.error ("primary expected");
+		return error("primary expected");
+	}
+}
+
+/// Return the list of elements, or nilNode if there are none
+NodeRef Parser::list(const NodeRefs& elements) {
+	NodeRef list = nilNode;				// build the list, last element first
+	for (auto i = elements.rbegin(); i != elements.rend(); ++i)
+		list = tree.add(Node(Op::list, *i, list));
+
+	return list;
+}
+
+/** Vector literals and ranges
+ *
+ *	@return vector literal or range tree
+ */
+NodeRef Parser::vector() {
+	NodeRef first = expr(true);
+
+	if (ts.current().kind == Kind::colon) {	// [ first : last ] or [ first : last : step ]
+		Node n(Op::range, first, expr(true));
+		n.step = nilNode;
+		if (ts.current().kind == Kind::colon)
+			n.step = expr(true);
+
+		if (ts.current().kind != Kind::rb)
+			return error("']' expected");
+
+		ts.get();						// eat ']'
+		return tree.add(n);
 	}
+
+	NodeRefs elements(1, first, arena);
+	while (ts.current().kind == Kind::comma)
+		elements.push_back(expr(true));
+
+	if (ts.current().kind != Kind::rb)
+		return error("']' expected");
+	ts.get();							// eat ']'
+
+	return tree.add(Node(Op::vector, list(elements)));
+}
+
+/** Call of a function or procedure
+ *
+ *	@return call tree
+ */
+NodeRef Parser::call() {
+	const SymbolId sym = ts.current().sym;
+	if (ts.get().kind != Kind::lp)
+		return error("'(' expected");
+
+	NodeRefs args(arena);
+	if (ts.get().kind != Kind::rp) {
+		args.push_back(expr(false));
+		while (ts.current().kind == Kind::comma)
+			args.push_back(expr(true));
+
+		if (ts.current().kind != Kind::rp)
+			return error("')' expected");
+	}
+	ts.get();							// eat ')'
+
+	if (args.size() > 0xffff)
+		return error("too many arguments");
+	return tree.add(Node(sym, Op::call, list(args)));
 }
 
 /**	Terminal expressions, such as multiply and divide, or primaries
  *
  *	@param get get a new token if true
  *
- *	@return	Terminal expression value
+ *	@return	Terminal expression tree
  */
-double Parser::term(bool get) {
-	double left = prim(get);
+NodeRef Parser::term(bool get) {
+	NodeRef left = prim(get);
 
 	for (;;) {
 		switch(ts.current().kind) {
 			case Kind::mul:					// term * prim
-				left *= prim(true);
+				left = tree.add(Node(Op::mul, left, prim(true)));
 				break;
 
 			case Kind::div:					// term / prim
-				if (auto d = prim(true))
-					left /= d;
-				else
-					return driver.error("divide by 0");
+				left = tree.add(Node(Op::div, left, prim(true)));
 				break;
 
 			case Kind::expo:				// term ^ prim
-				left = Pow(left, prim(true));
+				left = tree.add(Node(Op::pow, left, prim(true)));
 				break;
 
 			case Kind::mod:					// term % prim
-				if (auto d = prim(true)) 
-					left = std::remainder(left, d);
-				else
-					return driver.error("divide by 0");
+				left = tree.add(Node(Op::mod, left, prim(true)));
 				break;
 
 			default:
@@ -158,23 +282,23 @@ double Parser::term(bool get) {
 	}
 }
 
-/** Expressions such as add, subtract, terminals or primaries
+/** Sums such as add, subtract, terminals or primaries
  *
  *	@param get get a new token if true
  *
- *	@return	expression value
+ *	@return	sum tree
  */
-double Parser::expr(bool get) {
-	double left = term(get);
+NodeRef Parser::sum(bool get) {
+	NodeRef left = term(get);
 
 	for (;;) {
 		switch (ts.current().kind) {
-			case Kind::plus:				// expr + term
-				left += term(true);
+			case Kind::plus:				// sum + term
+				left = tree.add(Node(Op::add, left, term(true)));
 				break;
 
-			case Kind::minus:				// expr - term
-				left -= term(true);
+			case Kind::minus:				// sum - term
+				left = tree.add(Node(Op::sub, left, term(true)));
 				break;
 
 			default:
@@ -183,79 +307,529 @@ double Parser::expr(bool get) {
 	}
 }
 
-/// Assignment statement
-void Parser::assign() {
-	const std::string name = ts.current().string_value;
-	SymValue& v = table[name];
+/** Relations; comparisons of sums
+ *
+ *	@param get get a new token if true
+ *
+ *	@return	relation tree
+ */
+NodeRef Parser::relation(bool get) {
+	NodeRef left = sum(get);
+
+	for (;;) {
+		switch (ts.current().kind) {
+			case Kind::lt:	left = tree.add(Node(Op::lt, left, sum(true)));	break;
+			case Kind::le:	left = tree.add(Node(Op::le, left, sum(true)));	break;
+			case Kind::gt:	left = tree.add(Node(Op::gt, left, sum(true)));	break;
+			case Kind::ge:	left = tree.add(Node(Op::ge, left, sum(true)));	break;
+			case Kind::eq:	left = tree.add(Node(Op::eq, left, sum(true)));	break;
+			case Kind::ne:	left = tree.add(Node(Op::ne, left, sum(true)));	break;
+
+			default:
+				return left;
+		}
+	}
+}
+
+/** Conjunctions; relation && relation...
+ *
+ *	@param get get a new token if true
+ *
+ *	@return	conjunction tree
+ */
+NodeRef Parser::conjunction(bool get) {
+	NodeRef left = relation(get);
+
+	while (ts.current().kind == Kind::land)
+		left = tree.add(Node(Op::land, left, relation(true)));
+
+	return left;
+}
+
+/** Expressions; conjunction || conjunction...
+ *
+ *	@param get get a new token if true
+ *
+ *	@return	expression tree
+ */
+NodeRef Parser::expr(bool get) {
+	NodeRef left = conjunction(get);
+
+	while (ts.current().kind == Kind::lor)
+		left = tree.add(Node(Op::lor, left, conjunction(true)));
+
+	return left;
+}
+
+/** Assignment statement
+ *
+ *	@return	the assignment tree, or nilNode if the assignment is in error
+ */
+NodeRef Parser::assign() {
+	const SymbolId sym = ts.current().sym;
 
 	ts.get();							// consume identifier
-	if (v.kind == Kind::constant)
-		driver.error("can not modify constant variable", name);
+	if (table[sym].kind == Kind::constant) {
+		driver.error("can not modify constant variable", table.name(sym));
+		return nilNode;
+	}
+
+	return tree.add(Node(sym, Op::assign, expr(true)));
+}
+
+/// Optimize, and emit the code for, the expression tree at root; then discard the tree
+void Parser::emit(NodeRef root) {
+	code->emit(tree, optimizer(tree, root));
+	tree.clear();
+}
+
+/// Skip the rest of a statement in error
+void Parser::skip() {
+	for (;;) {
+		switch(ts.current().kind) {
+		case Kind::eos:
+		case Kind::rbrace:
+		case Kind::end:
+			return;
+
+		default:
+			ts.get();
+		}
+	}
+}
+
+/** Skip the rest of a statement with errors
+ *
+ *	Skips to the next ';' or newline outside of braces, or the end of input;
+ *	the rest of a block, or a stray '}', is skipped with it. A lexical error
+ *	also ends a token with eos, but isn't the end of the statement.
+ */
+void Parser::recover() {
+	for (unsigned depth = 0; ; ts.get()) {
+		const Token& t = ts.current();
+		switch(t.kind) {
+		case Kind::end:
+			return;
+
+		case Kind::lbrace:
+			++depth;
+			break;
+
+		case Kind::rbrace:
+			if (depth)
+				--depth;
+			break;
+
+		case Kind::eos:
+			if (!depth && (t.text == ";" || t.text == "\n"))
+				return;
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+/// Compile a condition; ( expression )
+void Parser::condition() {
+	if (ts.current().kind != Kind::lp)
+		driver.error("'(' expected");
+
+	emit(expr(ts.current().kind == Kind::lp));
+	if (ts.current().kind != Kind::rp)
+		driver.error("')' expected");
+	else
+		ts.get();						// eat ')'
+}
+
+/// Compile the body of an if, else, loop or definition; it may start on the next line
+void Parser::body() {
+	while (ts.current().kind == Kind::eos && ts.current().text == "\n")
+		ts.get();
+
+	if (ts.current().kind == Kind::end)
+		driver.error("statement expected");
 	else
-		v = expr(true);
+		statement(false);
+}
+
+/// Compile if ( expression ) statement [ else statement ]
+void Parser::conditional() {
+	ts.get();							// eat "if"
+	condition();
+
+	const unsigned skip = code->here();
+	code->emit(OpCode::jz);
+	body();
+
+	Token& t = ts.current();			// ';' else, or within { }, newline else
+	if (t.kind == Kind::eos && (t.text == ";" || nesting) && ts.next().kind == Kind::else_)
+		ts.get();
+
+	if (ts.current().kind != Kind::else_) {
+		code->patch(skip);
+		return;
+	}
+
+	ts.get();							// eat "else"
+	const unsigned done = code->here();
+	code->emit(OpCode::jump);
+	code->patch(skip);
+	body();
+	code->patch(done);
+}
+
+/// Compile while ( expression ) statement
+void Parser::whileLoop() {
+	ts.get();							// eat "while"
+
+	const unsigned top = code->here();
+	condition();
+	const unsigned exit = code->here();
+	code->emit(OpCode::jz);
+
+	loops.emplace_back();
+	body();
+	for (unsigned j : loops.back().continues)
+		code->code[j].arg = top;
+	code->emit(OpCode::jump, top);
+
+	code->patch(exit);
+	for (unsigned j : loops.back().breaks)
+		code->patch(j);
+	loops.pop_back();
 }
 
-/**	Lists of expressions and assignments...
+/** Compile for ( [expression] ; [expression] ; [expression] ) statement
  *
- *	@return The number of errors encountered.
+ *	The step follows the body in the code; its tree is held aside while the
+ *	body is compiled.
  */
-unsigned Parser::lists() {
+void Parser::forLoop() {
+	if (ts.get().kind != Kind::lp) {
+		driver.error("'(' expected");
+		return skip();
+	}
+
+	if (ts.get().kind != Kind::eos) {	// initialization
+		emit(expr(false));
+		code->emit(OpCode::pop);
+	}
+	if (ts.current().kind != Kind::eos || ts.current().text != ";") {
+		driver.error("';' expected");
+		return skip();
+	}
+
+	const unsigned top = code->here();
+	unsigned exit = ~0u;
+	if (ts.get().kind != Kind::eos) {	// condition
+		emit(expr(false));
+		exit = code->here();
+		code->emit(OpCode::jz);
+	}
+	if (ts.current().kind != Kind::eos || ts.current().text != ";") {
+		driver.error("';' expected");
+		return skip();
+	}
+
+	NodeRef step = nilNode;
+	if (ts.get().kind != Kind::rp)
+		step = expr(false);
+	if (ts.current().kind != Kind::rp) {
+		driver.error("')' expected");
+		return skip();
+	}
+	ts.get();							// eat ')'
+
+	Tree steps(arena);					// hold the step aside
+	std::swap(tree, steps);
+	loops.emplace_back();
+	body();
+
+	for (unsigned j : loops.back().continues)
+		code->patch(j);
+	if (nilNode != step) {
+		std::swap(tree, steps);
+		emit(step);
+		code->emit(OpCode::pop);
+	}
+	code->emit(OpCode::jump, top);
+
+	if (~0u != exit)
+		code->patch(exit);
+	for (unsigned j : loops.back().breaks)
+		code->patch(j);
+	loops.pop_back();
+}
+
+/// Compile break, if exit, otherwise continue
+void Parser::jump(bool exit) {
+	if (loops.empty())
+		driver.error(exit ? "break outside of a loop" : "continue outside of a loop");
+
+	else {
+		(exit ? loops.back().breaks : loops.back().continues).push_back(code->here());
+		code->emit(OpCode::jump);
+	}
+	ts.get();							// eat "break" or "continue"
+}
+
+/// Compile return [expression]
+void Parser::ret() {
+	switch(ts.get().kind) {				// eat "return"; is there a value?
+	case Kind::eos:
+	case Kind::rbrace:
+	case Kind::else_:
+	case Kind::end:
+		if (noSymbol == defining)
+			driver.error("return outside of a function or procedure");
+		else if (table[defining].kind == Kind::function)
+			driver.error("function return value expected", table.name(defining));
+		else
+			code->emit(OpCode::ret, 0);
+		break;
+
+	default:
+		emit(expr(false));
+		if (noSymbol != defining && table[defining].kind == Kind::function)
+			code->emit(OpCode::ret, 1);
+
+		else {
+			code->emit(OpCode::pop);
+			if (noSymbol == defining)
+				driver.error("return outside of a function or procedure");
+			else
+				driver.error("procedure returns a value", table.name(defining));
+		}
+	}
+}
+
+/** Compile a function or procedure definition; func name ( ) statement
+ *
+ *	The body is compiled, once, into Code owned by the parser, and referred to
+ *	by the name's symbol. Redefinition replaces the body in place. The name is
+ *	defined before the body is compiled, so that it may call itself. "last",
+ *	where results are saved, may not be defined, and a function may not be
+ *	redefined as a procedure, nor a procedure as a function; calls compiled
+ *	earlier use it as it was.
+ */
+void Parser::define() {
+	const Kind kind = ts.current().kind == Kind::func ? Kind::function : Kind::procedure;
+
+	const Token& t = ts.get();			// eat "func" or "proc"
+	if (t.kind != Kind::name && t.kind != Kind::function && t.kind != Kind::procedure) {
+		driver.error("function name expected");
+		return skip();
+	}
+
+	const SymbolId sym = t.sym;
+	const Kind was = table[sym].kind;
+	if (sym == last || (was != Kind::undefined && was != kind)) {
+		driver.error("can not redefine", table.name(sym));
+		return skip();
+	}
+
+	if (ts.get().kind != Kind::lp) {
+		driver.error("'(' expected");
+		return skip();
+	} else if (ts.get().kind != Kind::rp) {
+		driver.error("')' expected");
+		return skip();
+	}
+	ts.get();							// eat ')'
+
+	std::unique_ptr<Code>& p = bodies[sym];
+	if (!p)
+		p.reset(new Code);
+	const SymValue previous = table[sym];
+	table[sym] = SymValue(kind, p.get());	// for recursive calls
+
+	const unsigned errors = driver.nErrors;
+	Code compiled;
+	Code* const outer = code;
+	code = &compiled;
+	defining = sym;
+	body();
+	compiled.emit(OpCode::halt);
+	code = outer;
+	defining = noSymbol;
+
+	if (errors != driver.nErrors)
+		table[sym] = previous;			// keep any previous definition
+	else {
+		*p = std::move(compiled);
+		defined.push_back(sym);
+	}
+}
+
+/// Compile { statement_list }
+void Parser::block() {
+	++nesting;
+	ts.get();							// eat '{'
+
 	for (;;) {
-		ts.get();
-		if (ts.current().kind == Kind::end)
+		switch(ts.current().kind) {
+		case Kind::eos:
+			ts.get();
 			break;
 
-		if (ts.current().kind == Kind::eos)
-			continue;
+		case Kind::rbrace:
+			ts.get();					// eat '}'
+			--nesting;
+			return;
+
+		case Kind::end:
+			driver.error("'}' expected");
+			--nesting;
+			return;
+
+		default: {
+			const unsigned errors = driver.nErrors;
+			statement(false);
+			switch(ts.current().kind) {
+			case Kind::eos:
+			case Kind::rbrace:
+			case Kind::end:
+				break;
 
-		if (ts.current().kind == Kind::name && ts.next().kind == Kind::assign) {
-			assign();
-			continue;							// Don't print assigned values
+			default:
+				if (errors == driver.nErrors)
+					driver.error("syntax error");
+				skip();
+			}
+		}
 		}
+	}
+}
 
-		// Print and save last result in "last"
+/** Compile a statement
+ *
+ *	Top level expression statements print, and save their value in "last";
+ *	everything else is silent. If the driver is quiet, nothing's printed, and
+ *	top level assignments save their value in "last" too.
+ *
+ *	@param	top		Is this a top level statement?
+ */
+void Parser::statement(bool top) {
+	switch(ts.current().kind) {
+	case Kind::eos:						// empty statement
+		return;
+
+	case Kind::lbrace:	return block();
+	case Kind::if_:		return conditional();
+	case Kind::while_:	return whileLoop();
+	case Kind::for_:	return forLoop();
+	case Kind::break_:	return jump(true);
+	case Kind::continue_:	return jump(false);
+	case Kind::return_:	return ret();
+
+	case Kind::func:
+	case Kind::proc:
+		if (top)
+			return define();
+		driver.error("definitions are only allowed at the top level");
+		return skip();
+
+	case Kind::print:					// print expression_list
+		do {
+			emit(expr(true));
+			code->emit(OpCode::print, last);
+		} while (ts.current().kind == Kind::comma);
+		return;
+
+	case Kind::procedure:				// procedure ( expression_list )
+		emit(call());
+		code->emit(OpCode::pop);
+		return;
 
-		double& v = (table["last"] = expr(false))->u.value;
-		std::cout << '\t' << v << '\n';
+	default:
+		break;
 	}
 
-	return driver.nErrors;
+	if (!top) {
+		emit(expr(false));
+		code->emit(OpCode::pop);
+
+	} else if (ts.current().kind == Kind::name && ts.next().kind == Kind::assign) {
+		NodeRef n = assign();
+		if (nilNode != n) {
+			emit(n);
+			if (driver.quiet)
+				code->emit(OpCode::print, last);
+			else
+				code->emit(OpCode::pop);	// Don't print assigned values
+		}
+
+	} else {							// Print and save last result in "last"
+		emit(expr(false));
+		code->emit(OpCode::print, last);
+	}
 }
 
+// public:
+
 /** Construct a parser...
  *
  *	Results in a parser reading from standard input.
  *
  *	@param	drv		The parser driver
  */
-Parser::Parser(Driver& drv) : driver{drv}, ts{drv.ts}, table{drv.table} {
-	if (!table.empty()) return;					// Install constants, built-ins just once
-	
-	table["pi"]		= SymValue( 3.14159265358979323846);
-	table["e"]		= SymValue( 2.71828182845904523536);	// Base of natural logarithms
-	table["gamma"]	= SymValue( 0.57721566490153286060);	// Euler-Mascheroni constant
-	table["deg"]	= SymValue(57.29577951308232087680);	// Degress/radian
-	table["phi"]	= SymValue( 1.61803398874989484820);	// The Golden ratio
-	
-	table["rand"]	= SymValue(Rand);
-
-	table["sin"]	= SymValue(sin);
-	table["cos"]	= SymValue(cos);
-	table["atan"]	= SymValue(atan);
-	table["log"]	= SymValue(Log);			// checks argument
-	table["log10"]	= SymValue(Log10);			// checks argument
-	table["exp"]	= SymValue(Exp);			// checks argument
-	table["sqrt"]	= SymValue(Sqrt);			// checks argument
-	table["int"]	= SymValue(Integer);		// checks argument
-	table["abs"]	= SymValue(fabs);			// checks argument
-
-	table["atan2"]	= SymValue(atan2);
+Parser::Parser(Driver& drv)
+	: driver{drv}, ts{drv.ts}, table{drv.table}, tree{arena}, last{table.intern("last")}, optimizer{table, arena},
+	  code{nullptr}, defining{noSymbol}, nesting{0} {
+}
+
+/// Define sym, a function or procedure of kind, as body; as if it had been compiled
+void Parser::install(SymbolId sym, Kind kind, const Code& body) {
+	std::unique_ptr<Code>& p = bodies[sym];
+	if (!p)
+		p.reset(new Code);
+	*p = body;
+	table[sym] = SymValue(kind, p.get());
 }
 
-/**	Parse calculator/hoc program(s)...
+/**	Compile the next top level statement
  *
- *	@return The number of errors encountered.
+ *	Expression statements print, and save their value in "last", assignments
+ *	are silent. Function and procedure definitions are compiled into their
+ *	own Code, and skipped over.
+ *
+ *	@param	c	Compiled statement
+ *
+ *	@return false at the end of input.
  */
-unsigned Parser::operator()() {
-	return lists();
+bool Parser::operator()(Code& c) {
+	defined.clear();
+
+	for (;;) {
+		tree.clear();
+		arena.reset();
+		c.clear();
+		code = &c;
+		nesting = 0;
+		loops.clear();
+
+		const unsigned errors = driver.nErrors;	// including those in the first token
+		const Token& t = ts.get();
+		if (t.kind == Kind::end)
+			return false;
+
+		driver.stmtLine = t.line;
+		driver.stmtColumn = t.column;
+		statement(true);
+
+		const Kind k = ts.current().kind;
+		if (k != Kind::eos && k != Kind::end && errors == driver.nErrors)
+			driver.error("unexpected", ts.current().text);
+		if (errors != driver.nErrors) {
+			recover();					// discard the statement
+			continue;
+		}
+		if (c.code.empty())
+			continue;					// nothing to run
+
+		c.emit(OpCode::halt);
+		return true;
+	}
 }
@@ -9,6 +9,13 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "code.h"
+#include "optimizer.h"
 #include "symbol.h"
 
 class Driver;
@@ -20,24 +27,59 @@ class TokenStream;
  *	calc from TC++PL, 4th Edition by Stroustrup. The calc approch of breaking up expressions into
  *  expressions, terminal and primaries was used for it's readability.
  *
+ *	Rather than evaluating expressions as they're parsed, each statement is parsed into a Tree,
+ *	optimized, and then compiled into Code for the VM to execute; parsing is paid for once per
+ *	statement.
+ *
+ *	Statements are compiled once; a loop's body is byte-code that the VM jumps back to, and
+ *	functions and procedures are compiled, once, when they're defined. Only top level expression
+ *	statements print.
+ *
  *	@section	Grammar
  *
  *	    program:
  *		    end							- end of input
- *		    expr_list end
+ *		    statement_list end
  *
- *	    expr_list:
- *		    assign
- *		    assign expr_list
- *		    expression print
- *		    expression print expr_list
+ *	    statement_list:
+ *		    statement
+ *		    statement eos statement_list
+ *
+ *	    statement:
+ *		    assign						- silent
+ *		    expression					- printed, at the top level
+ *		    print expression_list
+ *		    { statement_list }
+ *		    if ( expression ) statement
+ *		    if ( expression ) statement else statement
+ *		    while ( expression ) statement
+ *		    for ( [expression] ; [expression] ; [expression] ) statement
+ *		    break						- in loops only
+ *		    continue					- in loops only
+ *		    return						- in procedures only
+ *		    return expression			- in functions only
+ *		    procedure ( [expression_list] )
+ *		    func name ( ) statement		- at the top level only
+ *		    proc name ( ) statement		- at the top level only
  *
  *	    assign:
  *		    name = expression
  *
- *	    expresson:
- *		    expression + term
- *		    expression - term
+ *	    expression:
+ *		    expression || conjunction
+ *		    conjunction
+ *
+ *	    conjunction:
+ *		    conjunction && relation
+ *		    relation
+ *
+ *	    relation:
+ *		    relation < sum				- and <=, >, >=, == or !=
+ *		    sum
+ *
+ *	    sum:
+ *		    sum + term
+ *		    sum - term
  *		    term
  *
  *	    term:
@@ -54,30 +96,108 @@ class TokenStream;
  *		    builtin ()				- built in functions
  *		    builtin1 ( expression )
  *		    builtin2 (expresson, expresson)
- *		    assign
+ *		    builtinv ( expression )	- vector reductions
+ *		    function ( [expression_list] ) - user defined functions
+ *		    $n						- argument n, in function and procedure definitions
+ *		    $n = expression
+ *		    load ( string )			- vector read from a file
+ *		    [ expression_list ]		- vector literal
+ *		    [ expression : expression ]	- range, first : last
+ *		    [ expression : expression : expression ] - range, first : last : step
  *		    +primary				- unary plus
  *			-primary				- unary minus
+ *			!primary				- logical not
  *			( expression )
+ *
+ *	    expression_list:
+ *		    expression
+ *		    expression , expression_list
+ *
+ *	Vector operands apply arithmetic, comparisons and builtin1/builtin2 functions element by
+ *	element, with scalar operands applied to each element.
+ *
+ *	As in hoc, comparisons and the logical operators result in 1 or 0, and both operands of &&
+ *	and || are evaluated. A condition is true if it's neither 0 nor NaN. A newline may follow
+ *	the ')' of if, while, for and function headers, and else; within { }, else may also follow
+ *	a newline.
  */
 
 class Parser {
+	/// The jumps out of, and to the end of, an enclosing loop's body; patched after the body
+	struct Loop {
+		std::vector<unsigned>	breaks;		///< break's
+		std::vector<unsigned>	continues;	///< continue's
+	};
+
+	/// Operand lists, while they're being parsed
+	typedef std::vector<NodeRef, ArenaAllocator<NodeRef>> NodeRefs;
+
 	Driver&			driver;				///< The driver
 	TokenStream&	ts;					///< The token stream (scanner)
 	SymbolTable&	table;				///< The symbol table
+	Arena			arena;				///< The current statement's scratch storage; reset per statement
+	Tree			tree;				///< The current expression's parse tree
+	const SymbolId	last;				///< "last", the last printed value
+	Optimizer		optimizer;			///< Folds constants, and shares sub-expressions
+	Code*			code;				///< The code being compiled; a statement or a body
+	SymbolId		defining;			///< The function or procedure being defined, or noSymbol
+	unsigned		nesting;			///< Depth of { }
+	std::vector<Loop>	loops;			///< The enclosing loops, innermost last
+	std::unordered_map<SymbolId, std::unique_ptr<Code>> bodies;	///< Function and procedure bodies
+	std::vector<SymbolId>	defined;	///< Functions, and procedures, defined by the last compile
+
+	NodeRef error(const std::string& s);
+	NodeRef error(const std::string& s, std::string_view t);
+	NodeRef error(const std::string& s, const Token& t);
 
 	// The parser itself
 
-	double prim(bool get);
-	double term(bool get);
-	double expr(bool get);
-	void assign();
-	unsigned lists();
+	NodeRef list(const NodeRefs& elements);
+	NodeRef vector();
+	NodeRef call();
+	NodeRef prim(bool get);
+	NodeRef term(bool get);
+	NodeRef sum(bool get);
+	NodeRef relation(bool get);
+	NodeRef conjunction(bool get);
+	NodeRef expr(bool get);
+	NodeRef assign();
+
+	// Statements, compiled into code
+
+	void emit(NodeRef root);
+	void skip();
+	void recover();
+	void condition();
+	void body();
+	void conditional();
+	void whileLoop();
+	void forLoop();
+	void jump(bool exit);
+	void ret();
+	void define();
+	void block();
+	void statement(bool top);
 
 public:
 	Parser(Driver& d);
 	virtual ~Parser()	{}
 
-	unsigned operator()();
+	bool operator()(Code& code);
+
+	/// Scratch bytes allocated compiling the current statement
+	size_t bytes() const				{	return arena.bytes();	}
+
+	/// The functions, and procedures, defined while compiling the last statement
+	const std::vector<SymbolId>& definitions() const	{	return defined;	}
+
+	/// Return the body of function or procedure sym
+	const Code& body(SymbolId sym) const	{	return *bodies.at(sym);	}
+
+	/// Return the body of function or procedure sym
+	Code& body(SymbolId sym)				{	return *bodies.at(sym);	}
+
+	void install(SymbolId sym, Kind kind, const Code& body);
 };
 
 #endif
@@ -0,0 +1,61 @@
+/** @file random.cpp
+ *
+ *	@brief	class Random implementation
+ *
+ *	The Philox rounds themselves are SIMD kernels; see simd().
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include "random.h"
+#include "simd.h"
+
+thread_local Random* Random::active = nullptr;
+
+// public:
+
+/// Return the current thread's generator; a thread local default if there's none
+Random& Random::current() {
+	static thread_local Random fallback;
+	return active ? *active : fallback;
+}
+
+/// Restart stream 0 of the generator seeded with s
+void Random::seed(uint64_t s) {
+	key = s;
+	stream(0);
+}
+
+/// Restart at the beginning of stream i
+void Random::stream(uint64_t i) {
+	index = i;
+	block = 0;
+	pending = false;
+}
+
+/// Return the next uniform value in [0, 1)
+double Random::uniform() {
+	if (pending) {
+		pending = false;
+		return spare;
+	}
+
+	double r[2];
+	simd().philox(r, key, index, block++, 1);
+	spare = r[1];
+	pending = true;
+	return r[0];
+}
+
+/// Set r[0..n) to the next n uniform values
+void Random::fill(double* r, size_t n) {
+	if (n && pending) {
+		*r++ = uniform();
+		--n;
+	}
+
+	simd().philox(r, key, index, block, n / 2);
+	block += n / 2;
+	if (n % 2)
+		r[n - 1] = uniform();
+}
@@ -0,0 +1,51 @@
+/** @file random.h
+ *
+ *	@brief	class Random
+ *
+ *	Counter-based pseudo random numbers; Philox4x32-10.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+
+/** A Philox4x32-10 generator of uniform doubles in [0, 1)
+ *
+ *	Each 128-bit counter value is encrypted, under a 64-bit key (the seed), into
+ *	two 52-bit uniforms. The counter's upper half is the stream index, and its
+ *	lower half the block within the stream, so streams never overlap, and any
+ *	block of any stream may be computed directly; fill() generates whole
+ *	arrays, several blocks at a time, and yields exactly the values that as many
+ *	calls to uniform() would.
+ *
+ *	Each driver has its own generator; the builtins use current().
+ */
+class Random {
+	uint64_t	key;					///< The seed
+	uint64_t	index;					///< The stream; upper half of the counter
+	uint64_t	block;					///< The next block; lower half of the counter
+	double		spare;					///< The second value of the last block...
+	bool		pending;				///< ... if not yet returned
+
+	static thread_local Random*	active;	///< The current thread's generator, or null
+
+public:
+	/// Construct stream 0 of the generator seeded with s
+	explicit Random(uint64_t s = 0)	{	seed(s);	}
+
+	static Random& current();
+
+	/// Make r the current thread's generator; null for a default
+	static void use(Random* r)			{	active = r;	}
+
+	void seed(uint64_t s);
+	void stream(uint64_t i);
+	double uniform();
+	void fill(double* r, size_t n);
+};
+
+#endif
@@ -0,0 +1,211 @@
+/** @file reactor.cpp
+ *
+ *	@brief	class Reactor implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "reactor.h"
+#include "driver.h"
+
+// private:
+
+/// Make room for symbols [0, n)
+void Reactor::grow(size_t n) {
+	if (defs.size() >= n)
+		return;
+
+	defs.resize(n);
+	dependents.resize(n);
+	level.resize(n, 0);
+	queued.resize(n, false);
+	mark.resize(n, 0);
+}
+
+/** Gather the variables code assigns, and reads, including those of the bodies it calls
+ *
+ *	@param	code	The statement, or body
+ *	@param	targets	Variables assigned are added here
+ *	@param	reads	Variables read are added here
+ *	@param	called	Functions, and procedures, whose bodies have been gathered
+ */
+void Reactor::collect(const Code& code, std::vector<SymbolId>& targets, std::vector<SymbolId>& reads,
+		std::vector<SymbolId>& called) const {
+	for (const Instr& in : code.code) {
+		if (in.op == OpCode::store)
+			targets.push_back(in.arg);
+		else if (in.op == OpCode::load)
+			reads.push_back(in.arg);
+		else if (in.op == OpCode::call && std::find(called.begin(), called.end(), in.arg) == called.end()) {
+			called.push_back(in.arg);
+			const SymValue& f = driver.table[in.arg];
+			if ((f.kind == Kind::function || f.kind == Kind::procedure) && f.u.code)
+				collect(*f.u.code, targets, reads, called);
+		}
+	}
+}
+
+/// Do any of the sorted symbols to depend on from, directly or otherwise?
+bool Reactor::reaches(SymbolId from, const std::vector<SymbolId>& to) {
+	if (to.empty() || dependents[from].empty())
+		return false;					// the usual cases; a constant, or a new variable
+
+	++stamp;
+	std::vector<SymbolId> stack { from };
+	while (!stack.empty()) {
+		const SymbolId id = stack.back();
+		stack.pop_back();
+
+		for (SymbolId d : dependents[id]) {
+			if (std::binary_search(to.begin(), to.end(), d))
+				return true;
+			else if (mark[d] != stamp) {
+				mark[d] = stamp;
+				stack.push_back(d);
+			}
+		}
+	}
+
+	return false;
+}
+
+/// Forget id's definition, if any; it becomes an input
+void Reactor::undefine(SymbolId id) {
+	if (!defs[id])
+		return;
+
+	for (SymbolId r : defs[id]->reads) {
+		std::vector<SymbolId>& ds = dependents[r];
+		ds.erase(std::find(ds.begin(), ds.end(), id));
+	}
+
+	defs[id].reset();
+}
+
+/** Record code, the statement just executed, as id's definition
+ *
+ *	@param	id		The variable
+ *	@param	code	Its compiled assignment; moved into the definition
+ *	@param	reads	Variables the assignment reads, sorted and unique
+ */
+void Reactor::define(SymbolId id, Code& code, std::vector<SymbolId>& reads) {
+	undefine(id);
+
+	std::unique_ptr<Definition> d(new Definition);
+	d->code = std::move(code);
+	d->reads.swap(reads);
+	d->line = driver.stmtLine;
+	d->column = driver.stmtColumn;
+
+	unsigned l = 0;
+	for (SymbolId r : d->reads) {
+		dependents[r].push_back(id);
+		l = std::max(l, level[r] + 1);
+	}
+
+	defs[id] = std::move(d);
+	level[id] = l;
+	raise(id);
+}
+
+/// Keep the levels of id's dependents above its own
+void Reactor::raise(SymbolId id) {
+	std::vector<SymbolId> stack { id };
+	while (!stack.empty()) {
+		const SymbolId s = stack.back();
+		stack.pop_back();
+
+		for (SymbolId d : dependents[s])
+			if (level[d] <= level[s]) {
+				level[d] = level[s] + 1;
+				stack.push_back(d);
+			}
+	}
+}
+
+/// Is v the same as was; the same kind and value?
+bool Reactor::same(const SymValue& v, const SymValue& was) {
+	if (v.kind != was.kind || v.exact != was.exact || bool(v.vec) != bool(was.vec))
+		return false;
+	else if (!was.vec)					// bitwise, so NaN is unchanged
+		return 0 == std::memcmp(&v.u, &was.u, sizeof v.u);
+	else if (v.vec == was.vec)
+		return true;
+
+	return v.vec->size() == was.vec->size()
+		&& 0 == std::memcmp(v.vec->data(), was.vec->data(), was.vec->size() * sizeof(double));
+}
+
+/// Queue id's dependents for re-evaluation
+void Reactor::changed(SymbolId id) {
+	for (SymbolId d : dependents[id])
+		if (!queued[d]) {
+			queued[d] = true;
+			queue.emplace(level[d], d);
+		}
+}
+
+/// Re-evaluate queued definitions, lowest level first, queuing the dependents of those that change
+void Reactor::propagate() {
+	SymbolTable& table = driver.table;
+	const unsigned line = driver.stmtLine, column = driver.stmtColumn;
+
+	while (!queue.empty()) {
+		const SymbolId id = queue.top().second;
+		queue.pop();
+		queued[id] = false;
+
+		const SymValue was = table[id];
+
+		driver.stmtLine = defs[id]->line;	// report errors at the definition
+		driver.stmtColumn = defs[id]->column;
+		driver.vm(defs[id]->code);
+		if (!same(table[id], was))
+			changed(id);
+	}
+
+	driver.stmtLine = line;
+	driver.stmtColumn = column;
+}
+
+// public:
+
+/** Record, and react to, an executed statement
+ *
+ *	@param	code	The statement; moved from if it becomes a definition
+ */
+void Reactor::operator()(Code& code) {
+	std::vector<SymbolId> targets, reads, called;
+	collect(code, targets, reads, called);
+	if (targets.empty())
+		return;							// not an assignment
+
+	bool branches = false;				// conditional, or a loop?
+	for (const Instr& in : code.code)
+		if (in.op == OpCode::jump || in.op == OpCode::jz)
+			branches = true;
+
+	grow(driver.table.size());
+	std::sort(reads.begin(), reads.end());
+	reads.erase(std::unique(reads.begin(), reads.end()), reads.end());
+	std::sort(targets.begin(), targets.end());
+	targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+	const std::vector<Instr>& c = code.code;
+	const SymbolId id = targets.front();
+	const bool single = targets.size() == 1 && !branches && c.size() >= 3
+		&& c[c.size() - 3].op == OpCode::store && c[c.size() - 2].op == OpCode::pop;
+
+	if (single && !std::binary_search(reads.begin(), reads.end(), id) && !reaches(id, reads))
+		define(id, code, reads);
+	else
+		for (SymbolId t : targets)
+			undefine(t);
+
+	for (SymbolId t : targets)
+		changed(t);
+	propagate();
+}
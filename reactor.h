@@ -0,0 +1,81 @@
+/** @file reactor.h
+ *
+ *	@brief	class Reactor
+ *
+ *	Reactive recomputation of variables defined in terms of others.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "code.h"
+#include "symbol.h"
+
+class Driver;
+
+/** A dependency graph over variables, kept up to date as they change
+ *
+ *	Statements that unconditionally assign a single variable, "name =
+ *	expression", become that variable's definition; the compiled statement,
+ *	where it is, and the variables it reads. Assigning a variable, by
+ *	definition or otherwise, re-evaluates the definitions that depend on it,
+ *	transitively, in topological order; errors are reported at the
+ *	definition. Those whose value didn't change don't trigger their own
+ *	dependents. Conditional assignments, such as "if (c) x = y", make the
+ *	variable an input. Variables read, and assigned, by the functions and
+ *	procedures a statement calls count as the statement's own; as their
+ *	bodies were when it was executed.
+ *
+ *	Each variable has a level, higher than that of every variable its
+ *	definition reads, ordering re-evaluation. Definitions that would make a
+ *	cycle, such as "x = x + 1", are evaluated once, and not recorded; the
+ *	variable is then an input, as are those assigned mid-expression, or in a
+ *	chain.
+ */
+class Reactor {
+	/// A variable's definition
+	struct Definition {
+		Code					code;	///< The compiled assignment
+		std::vector<SymbolId>	reads;	///< Variables read, sorted and unique
+		unsigned				line;	///< Line the definition began on
+		unsigned				column;	///< Column the definition began at
+	};
+
+	/// A variable queued for re-evaluation, by level
+	typedef std::pair<unsigned, SymbolId> Entry;
+
+	Driver&						driver;		///< The driver; runs definitions
+	std::vector<std::unique_ptr<Definition>> defs;	///< By SymbolId; null for inputs
+	std::vector<std::vector<SymbolId>> dependents;	///< By SymbolId; definitions that read it
+	std::vector<unsigned>		level;		///< By SymbolId; topological level
+	std::vector<bool>			queued;		///< By SymbolId; queued for re-evaluation?
+	std::vector<unsigned>		mark;		///< By SymbolId; visited stamp
+	unsigned					stamp;		///< Current visited stamp
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;	///< To re-evaluate
+
+	void grow(size_t n);
+	void collect(const Code& code, std::vector<SymbolId>& targets, std::vector<SymbolId>& reads,
+		std::vector<SymbolId>& called) const;
+	bool reaches(SymbolId from, const std::vector<SymbolId>& to);
+	void undefine(SymbolId id);
+	void define(SymbolId id, Code& code, std::vector<SymbolId>& reads);
+	void raise(SymbolId id);
+	static bool same(const SymValue& v, const SymValue& was);
+	void changed(SymbolId id);
+	void propagate();
+
+public:
+	/// Construct a reactor for the driver d
+	explicit Reactor(Driver& d) : driver{d}, stamp{0} {}
+
+	void operator()(Code& code);
+};
+
+#endif
@@ -0,0 +1,78 @@
+/** @file ring.h
+ *
+ *	@brief	class Ring
+ *
+ *	A lock-free, single producer, single consumer, ring buffer.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/** A bounded queue between exactly one producer thread and one consumer thread
+ *
+ *	Items are published in batches; push() makes an item visible to the
+ *	consumer only once the producer calls publish(), or the ring fills. The
+ *	consumer likewise returns the slots it has read only once it has read
+ *	everything published so far. Each side keeps a private copy of the other's
+ *	index, so the shared indices are touched about once per batch rather than
+ *	once per item. Neither side waits; push() and pop() return false instead.
+ */
+template<typename T>
+class Ring {
+	std::vector<T>		slots;			///< The items; a power of two of them
+	const size_t		mask;			///< slots.size() - 1
+
+	alignas(64) std::atomic<size_t>	head;	///< Next slot to read; written by the consumer
+	alignas(64) std::atomic<size_t>	tail;	///< Next slot to write; written by the producer
+
+	alignas(64) size_t	written;		///< Producer; next slot to write
+	size_t				freed;			///< Producer; head when last read
+
+	alignas(64) size_t	read;			///< Consumer; next slot to read
+	size_t				published;		///< Consumer; tail when last read
+
+public:
+	/// Construct a ring of n slots; n must be a power of two
+	explicit Ring(size_t n)
+		: slots(n), mask{n - 1}, head{0}, tail{0}, written{0}, freed{0}, read{0}, published{0} {}
+
+	Ring(const Ring&) = delete;
+	Ring& operator=(const Ring&) = delete;
+
+	/// Producer; append x, returning false, after publishing what's been written, if full
+	bool push(const T& x) {
+		if (written - freed == slots.size()) {
+			publish();
+			freed = head.load(std::memory_order_acquire);
+			if (written - freed == slots.size())
+				return false;
+		}
+
+		slots[written++ & mask] = x;
+		return true;
+	}
+
+	/// Producer; make everything written visible to the consumer
+	void publish()						{	tail.store(written, std::memory_order_release);	}
+
+	/// Consumer; remove the oldest item into x, returning false if there isn't one
+	bool pop(T& x) {
+		if (read == published) {
+			head.store(read, std::memory_order_release);
+			published = tail.load(std::memory_order_acquire);
+			if (read == published)
+				return false;
+		}
+
+		x = slots[read++ & mask];
+		return true;
+	}
+};
+
+#endif
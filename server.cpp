@@ -0,0 +1,308 @@
+/** @file server.cpp
+ *
+ *	@brief	class Server implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+
+/************************************************************************************************
+ *	Session																						*
+ ************************************************************************************************/
+
+/// Construct a session, with the program name and options of proto
+Server::Session::Session(const Driver& proto)
+	: driver{proto.progName, &transcript}, sent{0}, eof{false} {
+	driver.out.precision(proto.out.precision());
+	driver.jit = proto.jit;
+	driver.reactive = proto.reactive;
+	driver.memoize = proto.memoize;
+	driver.jsonErrors = proto.jsonErrors;
+	if (proto.stats)
+		driver.stats = &stats;
+}
+
+/************************************************************************************************
+ *	Server																						*
+ ************************************************************************************************/
+
+// private:
+
+/// Report a system call failure, and return EXIT_FAILURE
+int Server::error(const std::string& s) {
+	std::cerr << proto.progName << ": " << s << ": " << std::strerror(errno) << std::endl;
+	return EXIT_FAILURE;
+}
+
+/// Accept all pending connections
+void Server::accept() {
+	for (;;) {
+		const int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (EINTR == errno)
+				continue;
+			if (EAGAIN != errno && EWOULDBLOCK != errno)
+				error("accept");
+			return;
+		}
+
+		sessions[fd].reset(new Session(proto));
+
+		epoll_event ev {};
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.fd = fd;
+		if (0 != epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev)) {
+			error("epoll_ctl");
+			close(fd);
+		}
+	}
+}
+
+/** Read what's available from fd, unless the session's input, or output, is backed up
+ *
+ *	@return	false on error
+ */
+bool Server::receive(int fd, Session& s) {
+	char buf[64 * 1024];
+
+	while (!s.eof && s.in.size() < limit && s.out.size() - s.sent < limit) {
+		const ssize_t n = ::read(fd, buf, sizeof buf);
+		if (n > 0)
+			s.in.append(buf, n);
+		else if (0 == n)
+			s.eof = true;
+		else if (EINTR == errno)
+			continue;
+		else
+			return EAGAIN == errno || EWOULDBLOCK == errno;
+	}
+
+	return true;
+}
+
+/** Evaluate the session's complete requests, while its output isn't backed up
+ *
+ *	A final request without a newline is evaluated once the client is done
+ *	sending. Each request's line number is its position in the session. A
+ *	request of limit bytes, or more, is reported, and ends the session.
+ */
+void Server::evaluate(Session& s) {
+	size_t first = 0;
+
+	while (first < s.in.size() && s.out.size() - s.sent < limit) {
+		size_t last = s.in.find('\n', first);
+		if (std::string::npos == last) {
+			if (s.eof)
+				last = s.in.size();
+			else if (s.in.size() - first < limit)
+				break;					// wait for the rest of the request
+			else {						// too long; answer, and stop reading
+				s.driver.report({ Diagnostic::Code::syntax, s.driver.lineNum, 1,
+					"request longer than " + std::to_string(limit - 1) + " bytes" });
+				s.driver.err.flush();
+				s.transcript.drain(s.out);
+				s.out += '\n';
+				s.in.clear();
+				s.eof = true;
+				return;
+			}
+		}
+
+		s.driver.set_input(s.in.data() + first, last - first);
+		s.driver.parse();
+		++s.driver.lineNum;
+
+		s.transcript.drain(s.out);
+		s.out += '\n';
+		first = last + 1;
+	}
+
+	s.in.erase(0, first);
+}
+
+/** Send what fd will take of the session's output
+ *
+ *	@return	false on error
+ */
+bool Server::send(int fd, Session& s) {
+	while (s.sent < s.out.size()) {
+		const ssize_t n = ::send(fd, s.out.data() + s.sent, s.out.size() - s.sent, MSG_NOSIGNAL);
+		if (n >= 0)
+			s.sent += n;
+		else if (EINTR == errno)
+			continue;
+		else if (EAGAIN == errno || EWOULDBLOCK == errno)
+			break;
+		else
+			return false;
+	}
+
+	if (s.sent == s.out.size()) {
+		s.out.clear();
+		s.sent = 0;
+	}
+
+	return true;
+}
+
+/// Wait for input, unless the client is done or input, or output, is backed up, and to send output
+void Server::watch(int fd, const Session& s) {
+	epoll_event ev {};
+	ev.data.fd = fd;
+	if (!s.eof && s.in.size() < limit && s.out.size() - s.sent < limit)
+		ev.events |= EPOLLIN | EPOLLRDHUP;
+	if (s.sent < s.out.size())
+		ev.events |= EPOLLOUT;
+
+	if (0 != epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &ev))
+		error("epoll_ctl");
+}
+
+/// Close the connection on fd, ending its session; its statistics are merged into proto's
+void Server::close(int fd) {
+	epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+	::close(fd);
+
+	const auto i = sessions.find(fd);
+	if (i != sessions.end() && proto.stats) {
+		Session& s = *i->second;
+		s.stats.collect(s.driver);
+		proto.stats->merge(s.stats);
+	}
+	sessions.erase(fd);
+}
+
+// public:
+
+/** Construct a server
+ *
+ *	@param	proto	Supplies the program name, and each sessions options
+ *	@param	path	The socket's path
+ */
+Server::Server(const Driver& proto, const std::string& path)
+	: proto{proto}, path{path}, listener{-1}, epoll{-1}, signals{-1} {
+}
+
+/// Destructor; close every session, and remove the socket
+Server::~Server() {
+	while (!sessions.empty())
+		close(sessions.begin()->first);
+
+	if (signals >= 0)
+		::close(signals);
+
+	if (epoll >= 0)
+		::close(epoll);
+
+	if (listener >= 0) {
+		::close(listener);
+		unlink(path.c_str());
+	}
+}
+
+/** Serve clients until interrupted, or terminated
+ *
+ *	An existing socket at path is replaced; anything else there is an error.
+ *
+ *	@return	EXIT_SUCCESS, or EXIT_FAILURE if the server couldn't be started
+ */
+int Server::operator()() {
+	sockaddr_un addr {};
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof addr.sun_path) {
+		std::cerr << proto.progName << ": socket path too long: \'" << path << "\'" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::strcpy(addr.sun_path, path.c_str());
+
+	struct stat st;
+	if (0 == lstat(path.c_str(), &st) && S_ISSOCK(st.st_mode))
+		unlink(path.c_str());			// left by an earlier server
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return error("socket");
+
+	if (0 != bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr)) {
+		const int status = error("bind \'" + path + "\'");
+		::close(fd);
+		return status;
+	}
+	listener = fd;
+
+	if (0 != ::listen(listener, SOMAXCONN))
+		return error("listen");
+
+	if ((epoll = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return error("epoll_create1");
+
+	sigset_t mask;						// SIGINT and SIGTERM end the server
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, nullptr);
+	if ((signals = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+		return error("signalfd");
+
+	epoll_event ev {};
+	ev.events = EPOLLIN;
+	for (int f : { listener, signals }) {
+		ev.data.fd = f;
+		if (0 != epoll_ctl(epoll, EPOLL_CTL_ADD, f, &ev))
+			return error("epoll_ctl");
+	}
+
+	epoll_event events[64];
+	for (;;) {
+		const int n = epoll_wait(epoll, events, 64, -1);
+		if (n < 0 && EINTR == errno)
+			continue;
+		else if (n < 0)
+			return error("epoll_wait");
+
+		for (int i = 0; i < n; ++i) {
+			const int fd = events[i].data.fd;
+			if (signals == fd)
+				return EXIT_SUCCESS;
+
+			else if (listener == fd) {
+				accept();
+				continue;
+			}
+
+			const auto it = sessions.find(fd);
+			if (it == sessions.end())
+				continue;
+			Session& s = *it->second;
+
+			// Evaluate, and send, until the input is exhausted or the client stops reading
+			bool ok = receive(fd, s);
+			while (ok) {
+				const size_t pending = s.in.size();
+				evaluate(s);
+				ok = send(fd, s);
+				if (s.in.size() == pending || s.sent != 0 || !s.out.empty())
+					break;
+			}
+
+			if (!ok || (s.eof && s.in.empty() && s.out.empty()))
+				close(fd);
+			else
+				watch(fd, s);
+		}
+	}
+}
@@ -0,0 +1,76 @@
+/** @file server.h
+ *
+ *	@brief	class Server
+ *
+ *	Serves calculator sessions over a Unix domain socket.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "driver.h"
+#include "output.h"
+
+/** A calculator server
+ *
+ *	Accepts any number of concurrent clients on a Unix domain socket, driven
+ *	by a single epoll event loop. Each connection is a session with a Driver,
+ *	and so variables and an error count, of its own.
+ *
+ *	Requests are lines of one or more statements. Each is answered with its
+ *	results and diagnostics, in the order written, followed by an empty line.
+ *	Requests may be pipelined; responses are sent in request order, without
+ *	waiting for the client to read earlier ones, up to a limit, after which
+ *	the session's requests wait until the client catches up. Unevaluated
+ *	input is limited likewise; a request as long as the limit is an error,
+ *	which ends the session.
+ */
+class Server {
+	/// A client connection
+	struct Session {
+		Transcript	transcript;			///< The driver's output
+		Stats		stats;				///< The session's statistics, if proto's
+		Driver		driver;				///< The session's driver
+		std::string	in;					///< Input not yet evaluated
+		std::string	out;				///< Output not yet sent
+		size_t		sent;				///< Bytes of out sent
+		bool		eof;				///< Has the client finished sending?
+
+		Session(const Driver& proto);
+	};
+
+	/// Output queued, or input pending, before a session's input is left unread
+	static const size_t limit = 1024 * 1024;
+
+	const Driver&	proto;				///< Supplies the program name and options
+	std::string		path;				///< The socket's path
+	int				listener;			///< The listening socket
+	int				epoll;				///< The epoll instance
+	int				signals;			///< signalfd for SIGINT and SIGTERM
+	std::unordered_map<int, std::unique_ptr<Session>> sessions;	///< Sessions, by socket
+
+	int error(const std::string& s);
+	void accept();
+	bool receive(int fd, Session& s);
+	void evaluate(Session& s);
+	bool send(int fd, Session& s);
+	void watch(int fd, const Session& s);
+	void close(int fd);
+
+public:
+	Server(const Driver& proto, const std::string& path);
+	~Server();
+
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+
+	int operator()();
+};
+
+#endif
@@ -0,0 +1,233 @@
+/** @file simd.cpp
+ *
+ *	@brief	SIMD kernel implementation
+ *
+ *	Kernels are written once, as templates over GCC/Clang vector extension
+ *	types, and instantiated for each instruction set with the matching target
+ *	attribute. simd() picks the best set once, on first use.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define	X86	1							///< Runtime dispatch between SSE2 and AVX2
+#endif
+
+#define	INLINE	inline __attribute__((always_inline))
+
+// The vector types are only passed to, or returned from, always inlined functions, so the
+// warnings about the AVX calling convention don't apply.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef double v2d __attribute__((vector_size(16)));	///< Two doubles (SSE2)
+typedef double v4d __attribute__((vector_size(32)));	///< Four doubles (AVX2)
+typedef uint64_t v2u __attribute__((vector_size(16)));	///< Two 64-bit integers (SSE2)
+typedef uint64_t v4u __attribute__((vector_size(32)));	///< Four 64-bit integers (AVX2)
+
+static const double nan = std::numeric_limits<double>::quiet_NaN();
+
+/************************************************************************************************
+ *	Operations																					*
+ ************************************************************************************************/
+
+struct Add	{ template<class T> static INLINE T apply(const T& a, const T& b) { return a + b; } };
+struct Sub	{ template<class T> static INLINE T apply(const T& a, const T& b) { return a - b; } };
+struct Mul	{ template<class T> static INLINE T apply(const T& a, const T& b) { return a * b; } };
+struct Div	{ template<class T> static INLINE T apply(const T& a, const T& b) { return a / b; } };
+struct RSub	{ template<class T> static INLINE T apply(const T& a, const T& b) { return b - a; } };
+struct RDiv	{ template<class T> static INLINE T apply(const T& a, const T& b) { return b / a; } };
+struct Min	{ template<class T> static INLINE T apply(const T& a, const T& b) { return b < a ? b : a; } };
+struct Max	{ template<class T> static INLINE T apply(const T& a, const T& b) { return b > a ? b : a; } };
+
+/************************************************************************************************
+ *	Kernel templates																			*
+ ************************************************************************************************/
+
+/// Load a V from p, which need not be aligned
+template<class V> static INLINE V load(const double* p) {
+	V v;
+	std::memcpy(&v, p, sizeof v);
+	return v;
+}
+
+/// Store v at p, which need not be aligned
+template<class V> static INLINE void store(double* p, const V& v) {
+	std::memcpy(p, &v, sizeof v);
+}
+
+/// Number of doubles in a V
+template<class V> static constexpr size_t width() {
+	return sizeof(V) / sizeof(double);
+}
+
+/// r[i] = a[i] op b[i]
+template<class V, class Op> static INLINE void vv(const double* a, const double* b, double* r, size_t n) {
+	size_t i = 0;
+	for (; i + width<V>() <= n; i += width<V>())
+		store(r + i, Op::apply(load<V>(a + i), load<V>(b + i)));
+	for (; i < n; ++i)
+		r[i] = Op::apply(a[i], b[i]);
+}
+
+/// r[i] = a[i] op b
+template<class V, class Op> static INLINE void vs(const double* a, double b, double* r, size_t n) {
+	V bv = V{} + b;
+	size_t i = 0;
+	for (; i + width<V>() <= n; i += width<V>())
+		store(r + i, Op::apply(load<V>(a + i), bv));
+	for (; i < n; ++i)
+		r[i] = Op::apply(a[i], b);
+}
+
+/// r[i] = -a[i]
+template<class V> static INLINE void neg(const double* a, double* r, size_t n) {
+	size_t i = 0;
+	for (; i + width<V>() <= n; i += width<V>())
+		store(r + i, -load<V>(a + i));
+	for (; i < n; ++i)
+		r[i] = -a[i];
+}
+
+/// Fold a[0..n) with Op; n must not be zero
+template<class V, class Op> static INLINE double fold(const double* a, size_t n) {
+	size_t i = 0;
+	double acc;
+
+	if (n >= width<V>()) {
+		V v = load<V>(a);
+		for (i = width<V>(); i + width<V>() <= n; i += width<V>())
+			v = Op::apply(v, load<V>(a + i));
+
+		acc = v[0];
+		for (size_t j = 1; j < width<V>(); ++j)
+			acc = Op::apply(acc, v[j]);
+
+	} else
+		acc = a[i++];
+
+	for (; i < n; ++i)
+		acc = Op::apply(acc, a[i]);
+
+	return acc;
+}
+
+/// The 64-bit product of the lower 32 bits of a, and of m
+static INLINE uint64_t mul32(uint64_t a, uint64_t m) {
+	return (a & 0xffffffff) * (m & 0xffffffff);
+}
+
+/// The 64-bit products of the lower 32 bits of each lane of a, and of m
+template<class U> static INLINE U mul32(const U& a, const U& m) {
+	const uint64_t lo = 0xffffffff;
+	U b = m;
+#ifdef	X86
+	__asm__("" : "+x"(b));				// hide the constant, else it's shifts and adds
+#endif
+	return (a & lo) * (b & lo);
+}
+
+/** Philox4x32-10 rounds, under the key k0:k1, of the counters c0..c3
+ *
+ *	Each 32-bit word is held in a 64-bit integer, or vector lane, so that the
+ *	products are 32 x 32 -> 64-bit multiplies.
+ */
+template<class U> static INLINE void rounds(U& c0, U& c1, U& c2, U& c3, uint64_t k0, uint64_t k1) {
+	const uint64_t lo = 0xffffffff;
+
+	for (int round = 0; round < 10; ++round) {
+		const U p0 = mul32(c0, U{} + 0xd2511f53);
+		const U p1 = mul32(c2, U{} + 0xcd9e8d57);
+		c0 = (p1 >> 32) ^ c1 ^ k0;
+		c2 = (p0 >> 32) ^ c3 ^ k1;
+		c1 = p1 & lo;
+		c3 = p0 & lo;
+		k0 = (k0 + 0x9e3779b9) & lo;	// Weyl key schedule
+		k1 = (k1 + 0xbb67ae85) & lo;
+	}
+}
+
+/// Uniform [0, 1) doubles from the upper 52 bits of hi:lo; [1, 2), by bits, less 1
+template<class U, class V> static INLINE V uniform(const U& hi, const U& lo) {
+	const U bits = 0x3ff0000000000000ull | (hi << 32 | lo) >> 12;
+	V v;
+	std::memcpy(&v, &bits, sizeof v);
+	return v - 1;
+}
+
+/// Set r[0..2n) to the uniforms of blocks [block, block + n) of stream index, under key
+template<class U, class V> static INLINE void philox(double* r, uint64_t key, uint64_t index, uint64_t block, size_t n) {
+	const uint64_t k0 = key & 0xffffffff, k1 = key >> 32;
+	const uint64_t s0 = index & 0xffffffff, s1 = index >> 32;
+	U lane;
+	for (size_t j = 0; j < width<V>(); ++j)
+		lane[j] = j;
+
+	size_t i = 0;
+	for (; i + width<V>() <= n; i += width<V>()) {
+		const U b = block + i + lane;
+		U c0 = b & 0xffffffff, c1 = b >> 32, c2 = U{} + s0, c3 = U{} + s1;
+		rounds(c0, c1, c2, c3, k0, k1);
+
+		const V first = uniform<U, V>(c0, c1), second = uniform<U, V>(c2, c3);
+		for (size_t j = 0; j < width<V>(); ++j) {
+			r[2 * (i + j)] = first[j];
+			r[2 * (i + j) + 1] = second[j];
+		}
+	}
+
+	for (; i < n; ++i) {
+		const uint64_t b = block + i;
+		uint64_t c0 = b & 0xffffffff, c1 = b >> 32, c2 = s0, c3 = s1;
+		rounds(c0, c1, c2, c3, k0, k1);
+		r[2 * i] = uniform<uint64_t, double>(c0, c1);
+		r[2 * i + 1] = uniform<uint64_t, double>(c2, c3);
+	}
+}
+
+/// Define a complete kernel set named isa, over vector types V and U, with function attributes attr
+#define	KERNELS(isa, V, U, attr)																\
+attr static void add_##isa(const double* a, const double* b, double* r, size_t n)		{ vv<V, Add>(a, b, r, n); }		\
+attr static void adds_##isa(const double* a, double b, double* r, size_t n)			{ vs<V, Add>(a, b, r, n); }		\
+attr static void sub_##isa(const double* a, const double* b, double* r, size_t n)		{ vv<V, Sub>(a, b, r, n); }		\
+attr static void subs_##isa(const double* a, double b, double* r, size_t n)			{ vs<V, Sub>(a, b, r, n); }		\
+attr static void rsubs_##isa(const double* a, double b, double* r, size_t n)			{ vs<V, RSub>(a, b, r, n); }	\
+attr static void mul_##isa(const double* a, const double* b, double* r, size_t n)		{ vv<V, Mul>(a, b, r, n); }		\
+attr static void muls_##isa(const double* a, double b, double* r, size_t n)			{ vs<V, Mul>(a, b, r, n); }		\
+attr static void div_##isa(const double* a, const double* b, double* r, size_t n)		{ vv<V, Div>(a, b, r, n); }		\
+attr static void divs_##isa(const double* a, double b, double* r, size_t n)			{ vs<V, Div>(a, b, r, n); }		\
+attr static void rdivs_##isa(const double* a, double b, double* r, size_t n)			{ vs<V, RDiv>(a, b, r, n); }	\
+attr static void neg_##isa(const double* a, double* r, size_t n)						{ neg<V>(a, r, n); }			\
+attr static double sum_##isa(const double* a, size_t n)	{ return n ? fold<V, Add>(a, n) : 0.0; }						\
+attr static double min_##isa(const double* a, size_t n)	{ return n ? fold<V, Min>(a, n) : nan; }						\
+attr static double max_##isa(const double* a, size_t n)	{ return n ? fold<V, Max>(a, n) : nan; }						\
+attr static void philox_##isa(double* r, uint64_t key, uint64_t index, uint64_t block, size_t n)	{ philox<U, V>(r, key, index, block, n); }	\
+static const Kernels isa##_kernels = {																\
+	#isa, add_##isa, adds_##isa, sub_##isa, subs_##isa, rsubs_##isa, mul_##isa, muls_##isa,			\
+	div_##isa, divs_##isa, rdivs_##isa, neg_##isa, sum_##isa, min_##isa, max_##isa, philox_##isa	\
+};
+
+/************************************************************************************************
+ *	Kernel sets																					*
+ ************************************************************************************************/
+
+#ifdef	X86
+KERNELS(sse2, v2d, v2u, __attribute__((target("sse2"))))
+KERNELS(avx2, v4d, v4u, __attribute__((target("avx2"))))
+#else
+KERNELS(generic, v2d, v2u, )
+#endif
+
+const Kernels& simd() {
+#ifdef	X86
+	static const Kernels& k = __builtin_cpu_supports("avx2") ? avx2_kernels : sse2_kernels;
+	return k;
+#else
+	return generic_kernels;
+#endif
+}
@@ -0,0 +1,51 @@
+/** @file simd.h
+ *
+ *	@brief	struct Kernels
+ *
+ *	Element-wise, reduction and random number kernels over contiguous arrays of doubles,
+ *	vectorized for the best instruction set available at runtime (AVX2 or SSE2
+ *	on x86-64, generic otherwise).
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+/** Element-wise and reduction kernels
+ *
+ *	Binary kernels write r[i] = a[i] op b[i] (vector, vector), or r[i] = a[i]
+ *	op b (vector, scalar). The 'r' versions write r[i] = b op a[i] (scalar,
+ *	vector), for the non-commutative operations. The result, r, may be the
+ *	same array as a or b.
+ */
+struct Kernels {
+	const char* isa;					///< Instruction set name; "avx2", "sse2" or "generic"
+
+	void (*add)(const double* a, const double* b, double* r, size_t n);
+	void (*adds)(const double* a, double b, double* r, size_t n);
+	void (*sub)(const double* a, const double* b, double* r, size_t n);
+	void (*subs)(const double* a, double b, double* r, size_t n);
+	void (*rsubs)(const double* a, double b, double* r, size_t n);
+	void (*mul)(const double* a, const double* b, double* r, size_t n);
+	void (*muls)(const double* a, double b, double* r, size_t n);
+	void (*div)(const double* a, const double* b, double* r, size_t n);
+	void (*divs)(const double* a, double b, double* r, size_t n);
+	void (*rdivs)(const double* a, double b, double* r, size_t n);
+	void (*neg)(const double* a, double* r, size_t n);
+
+	double (*sum)(const double* a, size_t n);	///< Sum of a[0..n), 0 if empty
+	double (*min)(const double* a, size_t n);	///< Minimum of a[0..n), NaN if empty
+	double (*max)(const double* a, size_t n);	///< Maximum of a[0..n), NaN if empty
+
+	/// Philox4x32-10; r[0..2n) = the uniforms of blocks [block, block + n) of stream index, under key
+	void (*philox)(double* r, uint64_t key, uint64_t index, uint64_t block, size_t n);
+};
+
+/// Return the kernels for the best instruction set supported by this processor
+const Kernels& simd();
+
+#endif
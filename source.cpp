@@ -0,0 +1,139 @@
+/**	@file	source.cpp
+ *
+ *	@brief	Source implementation.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source.h"
+
+/************************************************************************************************
+ *	MappedSource																				*
+ ************************************************************************************************/
+
+/// Map the regular file open on fd, which may be closed once constructed
+MappedSource::MappedSource(int fd) : addr{nullptr}, len{0}, ok{false} {
+	struct stat st;
+	if (0 != fstat(fd, &st) || !S_ISREG(st.st_mode))
+		return;
+
+	len = st.st_size;
+	if (0 == len) {
+		ok = true;						// nothing to map
+		return;
+	}
+
+	addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (MAP_FAILED == addr) {
+		addr = nullptr;
+		return;
+	}
+
+	ok = true;
+	madvise(addr, len, MADV_SEQUENTIAL);
+	first = static_cast<const char*>(addr);
+	last = first + len;
+}
+
+/// Destructor
+MappedSource::~MappedSource() {
+	if (addr)
+		munmap(addr, len);
+}
+
+/************************************************************************************************
+ *	ChunkedSource																				*
+ ************************************************************************************************/
+
+/** Construct a source reading from fd
+ *
+ *	@param	fd		The file descriptor
+ *	@param	owns	Close fd once done?
+ */
+ChunkedSource::ChunkedSource(int fd, bool owns) : fd{fd}, owns{owns}, buf{nullptr}, cap{0} {
+}
+
+/// Destructor
+ChunkedSource::~ChunkedSource() {
+	free(buf);
+	if (owns)
+		close(fd);
+}
+
+/** Read the next chunk, preserving [keep, end())
+ *
+ *	Reads return what's available, so interactive input is seen a line at a
+ *	time. The buffer grows only if a single token outgrows it.
+ */
+bool ChunkedSource::more(const char*& keep) {
+	const size_t kept = last - keep;
+	base += keep - first;
+
+	if (kept == cap) {					// grow; the buffer is allocated on first use
+		cap = cap ? cap * 2 : chunk;
+		char* p = static_cast<char*>(malloc(cap));
+		if (!p)
+			throw std::bad_alloc();
+		if (kept)
+			memcpy(p, keep, kept);
+		free(buf);
+		buf = p;
+
+	} else if (kept)
+		memmove(buf, keep, kept);
+
+	first = keep = buf;
+	last = buf + kept;
+
+	ssize_t n;
+	do
+		n = read(fd, buf + kept, cap - kept);
+	while (n < 0 && EINTR == errno);
+
+	if (n <= 0)
+		return false;
+
+	last += n;
+	return true;
+}
+
+/************************************************************************************************
+ *	Opening files																				*
+ ************************************************************************************************/
+
+/** Open file for scanning
+ *
+ *	Regular files are memory mapped, anything else is read in chunks; "-" is
+ *	standard input.
+ *
+ *	@param	file	The file name
+ *
+ *	@return	The new source, or nullptr if file couldn't be opened
+ */
+Source* openSource(const std::string& file) {
+	if ("-" == file)
+		return new ChunkedSource(0, false);
+
+	const int fd = ::open(file.c_str(), O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	MappedSource* ms = new MappedSource(fd);
+	if (ms->mapped()) {
+		::close(fd);
+		return ms;
+	}
+
+	delete ms;
+	return new ChunkedSource(fd, true);
+}
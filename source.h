@@ -0,0 +1,102 @@
+/**	@file	source.h
+ *
+ *	@brief	class Source, MemorySource, MappedSource and ChunkedSource
+ *
+ *	Input buffers scanned, in place, by the TokenStream.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <cstddef>
+#include <string>
+
+/** An input buffer
+ *
+ *	The TokenStream scans [begin(), end()) directly. Sources that can't hold all
+ *	of their input at once (ChunkedSource) provide more() to slide the window
+ *	along the input; everything else is available up front.
+ */
+class Source {
+protected:
+	const char*	first;					///< Start of the available input
+	const char*	last;					///< End of the available input
+	size_t		base;					///< Offset of first from the start of input
+
+public:
+	/// Construct an empty source
+	Source() : first{nullptr}, last{nullptr}, base{0} {}
+	virtual ~Source()					{}
+
+	Source(const Source&) = delete;
+	Source& operator=(const Source&) = delete;
+
+	/// Start of the available input
+	const char* begin() const			{	return first;			}
+
+	/// End of the available input
+	const char* end() const				{	return last;			}
+
+	/// Return the offset of p, in [begin(), end()], from the start of the input
+	size_t offset(const char* p) const	{	return base + (p - first);	}
+
+	/** Make more input available, discarding input before keep
+	 *
+	 *	@param	keep	Start of the input to preserve; updated to its new location
+	 *
+	 *	@return	false if there's no more input
+	 */
+	virtual bool more(const char*& keep)	{	(void)keep; return false;	}
+
+	/// Is all of the input available, and will it stay where it is?
+	virtual bool complete() const		{	return true;	}
+};
+
+/// An in-memory buffer, owned by the caller, that must outlive the source
+class MemorySource : public Source {
+public:
+	/// Scan the n characters at s
+	MemorySource(const char* s, size_t n) {
+		first = s;
+		last = s + n;
+	}
+};
+
+/// A memory mapped file
+class MappedSource : public Source {
+	void*		addr;					///< Mapped address, or null
+	size_t		len;					///< Mapped length
+	bool		ok;						///< Mapped?
+
+public:
+	explicit MappedSource(int fd);
+	~MappedSource();
+
+	/// Was the file successfully mapped?
+	bool mapped() const					{	return ok;	}
+};
+
+/// A file descriptor, read in large chunks; standard input, pipes and devices
+class ChunkedSource : public Source {
+	int			fd;						///< The file descriptor
+	bool		owns;					///< Close fd when done?
+	char*		buf;					///< The read buffer
+	size_t		cap;					///< The read buffer's capacity
+
+public:
+	static const size_t chunk = 64 * 1024;	///< Initial read buffer size
+
+	ChunkedSource(int fd, bool owns);
+	~ChunkedSource();
+
+	bool more(const char*& keep) override;
+
+	/// Input is read, and moved, as it's scanned
+	bool complete() const override		{	return false;	}
+};
+
+Source* openSource(const std::string& file);
+
+#endif
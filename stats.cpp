@@ -0,0 +1,203 @@
+/** @file stats.cpp
+ *
+ *	@brief	class Stats implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <utility>
+
+#include "stats.h"
+#include "driver.h"
+
+/// Return the name of token kind k
+static std::string name(Kind k) {
+	switch(k) {
+	case Kind::none:		return "none";
+	case Kind::name:		return "name";
+	case Kind::constant:	return "constant";
+	case Kind::undefined:	return "undefined";
+	case Kind::builtin:		return "builtin";
+	case Kind::builtin1:	return "builtin1";
+	case Kind::builtin2:	return "builtin2";
+	case Kind::builtinv:	return "builtinv";
+	case Kind::function:	return "function";
+	case Kind::procedure:	return "procedure";
+	case Kind::load:		return "load";
+	case Kind::while_:		return "while";
+	case Kind::if_:			return "if";
+	case Kind::else_:		return "else";
+	case Kind::for_:		return "for";
+	case Kind::func:		return "func";
+	case Kind::proc:		return "proc";
+	case Kind::return_:		return "return";
+	case Kind::break_:		return "break";
+	case Kind::continue_:	return "continue";
+	case Kind::print:		return "print";
+	case Kind::number:		return "number";
+	case Kind::string:		return "string";
+	case Kind::arg:			return "$n";
+	case Kind::le:			return "<=";
+	case Kind::ge:			return ">=";
+	case Kind::eq:			return "==";
+	case Kind::ne:			return "!=";
+	case Kind::land:		return "&&";
+	case Kind::lor:			return "||";
+	case Kind::end:			return "end";
+	case Kind::eos:			return "eos";
+	default:				return std::string(1, char(k));
+	}
+}
+
+/// Write s as a JSON string
+static void quoted(std::ostream& os, const std::string& s) {
+	os << '"';
+	for (char ch : s) {
+		if (ch == '"' || ch == '\\')
+			os << '\\';
+		os << ch;
+	}
+	os << '"';
+}
+
+// private:
+
+/// Convert t ticks to seconds
+double Stats::seconds(uint64_t t) const {
+	const uint64_t elapsed = ticks() - ticked;
+	const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return elapsed ? t * (secs / elapsed) : 0;
+}
+
+/// Write the statistics as text
+void Stats::text(std::ostream& os) const {
+	auto line = [&os](const std::string& label) -> std::ostream& {
+		return os << "  " << std::left << std::setw(14) << label << std::right;
+	};
+
+	os << "statistics:\n";
+	line("lexing") << std::fixed << std::setprecision(6) << seconds(lexing) << " s\n";
+	line("parsing") << seconds(parsing) << " s\n";
+	line("evaluation") << seconds(evaluating) << " s\n";
+	os.unsetf(std::ios::floatfield);
+
+	line("statements") << statements << '\n';
+	line("native") << natives << '\n';
+	line("lookups") << lookups << '\n';
+	line("inserts") << inserts << '\n';
+	line("errors") << errors << '\n';
+	line("memo hits") << hits << '\n';
+	line("memo misses") << misses << '\n';
+	line("arena bytes") << arena << '\n';
+	line("  largest") << largest << '\n';
+	line("name bytes") << names << '\n';
+
+	uint64_t total = 0;
+	for (uint64_t n : tokens)
+		total += n;
+	line("tokens") << total << '\n';
+	for (unsigned k = 0; k < 128; ++k)
+		if (tokens[k])
+			line("  " + name(Kind(k))) << tokens[k] << '\n';
+
+	std::vector<std::pair<std::string, uint64_t>> byCount(named.begin(), named.end());
+	std::stable_sort(byCount.begin(), byCount.end(),
+		[](const auto& a, const auto& b) { return a.second > b.second; });
+
+	line("calls") << '\n';
+	for (const auto& c : byCount)
+		line("  " + c.first) << c.second << '\n';
+}
+
+/// Write the statistics as a single line JSON object
+void Stats::json(std::ostream& os) const {
+	os << std::setprecision(9) << "{\"time\":{\"lexing\":" << seconds(lexing)
+	   << ",\"parsing\":" << seconds(parsing) << ",\"evaluation\":" << seconds(evaluating) << '}'
+	   << ",\"statements\":" << statements << ",\"native\":" << natives
+	   << ",\"symbols\":{\"lookups\":" << lookups << ",\"inserts\":" << inserts << '}'
+	   << ",\"errors\":" << errors
+	   << ",\"memo\":{\"hits\":" << hits << ",\"misses\":" << misses << '}'
+	   << ",\"memory\":{\"arena\":" << arena << ",\"largest\":" << largest << ",\"names\":" << names << '}'
+	   << ",\"tokens\":{";
+
+	const char* sep = "";
+	for (unsigned k = 0; k < 128; ++k)
+		if (tokens[k]) {
+			os << sep;
+			quoted(os, name(Kind(k)));
+			os << ':' << tokens[k];
+			sep = ",";
+		}
+
+	os << "},\"calls\":{";
+	sep = "";
+	for (const auto& c : named) {
+		os << sep;
+		quoted(os, c.first);
+		os << ':' << c.second;
+		sep = ",";
+	}
+	os << "}}\n";
+}
+
+// public:
+
+volatile std::sig_atomic_t Stats::requested = 0;
+
+/// Construct empty statistics, reported as JSON if json
+Stats::Stats(bool json)
+	: start{std::chrono::steady_clock::now()}, ticked{ticks()}, asJson{json}, lexing{0}, parsing{0},
+	  evaluating{0}, statements{0}, natives{0}, tokens{}, lookups{0}, inserts{0}, errors{0}, hits{0}, misses{0}, arena{0}, largest{0}, names{0} {
+}
+
+/// Add the driver's errors, memo counts and name pool, and move calls by SymbolId into named
+void Stats::collect(const Driver& driver) {
+	errors += driver.nErrors;
+	names += driver.table.bytes();
+	hits += driver.memo.hits;
+	misses += driver.memo.misses;
+
+	for (SymbolId id = 0; id < calls.size(); ++id)
+		if (calls[id])
+			named[std::string(driver.table.name(id))] += calls[id];
+	calls.clear();
+}
+
+/// Add s, which has been collected, to these statistics
+void Stats::merge(const Stats& s) {
+	lexing += s.lexing;
+	parsing += s.parsing;
+	evaluating += s.evaluating;
+	statements += s.statements;
+	natives += s.natives;
+	for (unsigned k = 0; k < 128; ++k)
+		tokens[k] += s.tokens[k];
+	lookups += s.lookups;
+	inserts += s.inserts;
+	errors += s.errors;
+	hits += s.hits;
+	misses += s.misses;
+	arena += s.arena;
+	largest = std::max(largest, s.largest);
+	names += s.names;
+	for (const auto& c : s.named)
+		named[c.first] += c.second;
+}
+
+/** Report the statistics, with those of driver, which haven't been collected, to os
+ *
+ *	@param	driver	The driver these statistics are for
+ *	@param	os		The stream to write
+ */
+void Stats::report(const Driver& driver, std::ostream& os) const {
+	Stats s = *this;
+	s.collect(driver);
+
+	if (asJson)
+		s.json(os);
+	else
+		s.text(os);
+	os.flush();
+}
@@ -0,0 +1,107 @@
+/** @file stats.h
+ *
+ *	@brief	class Stats
+ *
+ *	Per phase timing, and hot path counters, for --stats.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "symbol.h"
+
+class Driver;
+
+/** Statistics gathered while calc runs
+ *
+ *	A Driver collects statistics only if its stats is set; otherwise each
+ *	instrumented site costs a single, never taken, branch on a null pointer.
+ *
+ *	Time is kept in ticks (the time stamp counter on x86-64), which are cheap
+ *	enough to read around each token, and converted to seconds by comparing
+ *	ticks, and the steady clock, since construction. Lexing time is the time
+ *	spent scanning tokens; parsing is the rest of the time spent compiling
+ *	statements, and evaluation the time spent executing them.
+ *
+ *	Calls are counted by SymbolId; builtins, and user defined functions and
+ *	procedures. Symbol table lookups, and inserts, are those made by the
+ *	scanner for the names in the program's text.
+ *
+ *	Memory is that of the parser's per statement arena; the total, and the
+ *	most any one statement used, and of the symbol table's name pool.
+ */
+class Stats {
+	std::chrono::steady_clock::time_point	start;	///< Clock at construction
+	uint64_t				ticked;		///< ticks() at construction
+
+	double seconds(uint64_t t) const;
+	void text(std::ostream& os) const;
+	void json(std::ostream& os) const;
+
+public:
+	/// Set by SIGUSR1; report at the end of the current statement
+	static volatile std::sig_atomic_t	requested;
+
+	bool					asJson;		///< Report as JSON, rather than text?
+	uint64_t				lexing;		///< Ticks spent scanning tokens
+	uint64_t				parsing;	///< Ticks spent compiling, less lexing
+	uint64_t				evaluating;	///< Ticks spent executing
+	uint64_t				statements;	///< Statements executed
+	uint64_t				natives;	///< Expressions run natively
+	uint64_t				tokens[128];	///< Tokens scanned, by Kind
+	uint64_t				lookups;	///< Symbol table lookups
+	uint64_t				inserts;	///< Symbol table inserts
+	uint64_t				errors;		///< Errors reported via the driver
+	uint64_t				hits;		///< Memo hits
+	uint64_t				misses;		///< Memo misses
+	uint64_t				arena;		///< Scratch bytes allocated compiling statements
+	uint64_t				largest;	///< Most scratch bytes allocated for a statement
+	uint64_t				names;		///< Bytes in the symbol table's name pool
+	std::vector<uint64_t>	calls;		///< Calls, by SymbolId
+	std::map<std::string, uint64_t>	named;	///< Calls, by name; from collect()
+
+	explicit Stats(bool json = false);
+
+	/// Return the current time, in ticks
+	static uint64_t ticks() {
+#if defined(__x86_64__)
+		return __rdtsc();
+#else
+		return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	/// Count a call of symbol id
+	void call(SymbolId id) {
+		if (id >= calls.size())
+			calls.resize(id + 1);
+		++calls[id];
+	}
+
+	/// Count n scratch bytes allocated compiling a statement
+	void scratch(uint64_t n) {
+		arena += n;
+		if (n > largest)
+			largest = n;
+	}
+
+	void collect(const Driver& driver);
+	void merge(const Stats& s);
+	void report(const Driver& driver, std::ostream& os) const;
+};
+
+#endif
@@ -1,12 +1,124 @@
 /** @file symbol.cpp
  *
- *	@brief	SymbolTable implemetation
+ *	@brief	SymValue and SymbolTable implemetation
  *
  *	Created by Randy Merkel on 6/7/2013.
  *	Copyright (c) 2016 Randy Merkel. All rights reserved.
  */
 
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+
 #include "symbol.h"
+#include "math.h"
+
+/************************************************************************************************
+ *	Builtins																					*
+ ************************************************************************************************/
+
+namespace {
+
+/// Names of the constants, builtins and keywords, by SymbolId
+constexpr std::string_view builtinNames[] = {
+	"pi", "e", "gamma", "deg", "phi",
+	"rand", "seed", "stream", "uniform",
+	"sin", "cos", "atan", "log", "log10", "exp", "sqrt", "int", "abs",
+	"atan2", "pow",
+	"sum", "min", "max", "mean", "len",
+	"load", "while", "if", "else", "for", "func", "proc", "return", "break", "continue", "print"
+};
+
+/// Values of the constants, builtins and keywords, in the same order as builtinNames
+const SymValue builtinValues[] = {
+	SymValue( 3.14159265358979323846),	// pi
+	SymValue( 2.71828182845904523536),	// e; base of natural logarithms
+	SymValue( 0.57721566490153286060),	// gamma; Euler-Mascheroni constant
+	SymValue(57.29577951308232087680),	// deg; degress/radian
+	SymValue( 1.61803398874989484820),	// phi; the Golden ratio
+
+	SymValue(Rand),
+	SymValue(Seed, false),
+	SymValue(Stream, false),
+	SymValue(Uniform, false),
+
+	SymValue(sin),
+	SymValue(cos),
+	SymValue(atan),
+	SymValue(Log),						// checks argument
+	SymValue(Log10),					// checks argument
+	SymValue(Exp),						// checks argument
+	SymValue(Sqrt),						// checks argument
+	SymValue(Integer),					// checks argument
+	SymValue(fabs),
+
+	SymValue(atan2),
+	SymValue(Pow),						// checks argument
+
+	SymValue(Sum),
+	SymValue(Min),
+	SymValue(Max),
+	SymValue(Mean),
+	SymValue(Len),
+
+	SymValue(Kind::load),
+	SymValue(Kind::while_),
+	SymValue(Kind::if_),
+	SymValue(Kind::else_),
+	SymValue(Kind::for_),
+	SymValue(Kind::func),
+	SymValue(Kind::proc),
+	SymValue(Kind::return_),
+	SymValue(Kind::break_),
+	SymValue(Kind::continue_),
+	SymValue(Kind::print)
+};
+
+constexpr size_t nNames = std::size(builtinNames);
+static_assert(nNames == std::size(builtinValues), "a builtin is missing its name or value");
+
+constexpr size_t nSlots = 256;			///< Perfect hash table size; a power of two
+static_assert(nNames < nSlots, "too many builtins for the perfect hash table");
+
+/// Hash s, a la FNV-1a, starting from seed
+constexpr uint32_t hash(std::string_view s, uint32_t seed) {
+	uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+	for (char ch : s)
+		h = (h ^ static_cast<unsigned char>(ch)) * 16777619u;
+	return h ^ (h >> 16);
+}
+
+/// A perfect hash of builtinNames; slot hash(name, seed) % nSlots holds name's SymbolId + 1, or 0
+struct PerfectHash {
+	uint32_t	seed;					///< Seed of the first collision free hash
+	uint8_t		slot[nSlots];			///< SymbolId + 1, or 0 if empty
+};
+
+/// Search for a seed that hashes each of builtinNames to a slot of its own; seed is 0 if there isn't one
+constexpr PerfectHash perfect() {
+	for (uint32_t seed = 1; seed < 10000; ++seed) {
+		PerfectHash p{ seed, {} };
+		bool collided = false;
+		for (size_t i = 0; i < nNames && !collided; ++i) {
+			uint8_t& s = p.slot[hash(builtinNames[i], seed) & (nSlots - 1)];
+			collided = s != 0;
+			s = static_cast<uint8_t>(i + 1);
+		}
+		if (!collided)
+			return p;
+	}
+
+	return PerfectHash{ 0, {} };
+}
+
+constexpr PerfectHash builtins = perfect();
+static_assert(builtins.seed != 0, "no perfect hash of the builtins");
+
+}
+
+/************************************************************************************************
+ *	SymValue																					*
+ ************************************************************************************************/
 
 /// Update as a defined variable
 SymValue* SymValue::operator=(double value) {
@@ -14,7 +126,86 @@ SymValue* SymValue::operator=(double value) {
 		throw const_error("cannot modify constant value");
 
 	kind = Kind::name;
+	exact = false;
 	u.value = value;
+	vec.reset();
+
+	return this;
+}
+
+/// Update as a defined integer variable
+SymValue* SymValue::operator=(int64_t value) {
+	if (Kind::undefined != kind && Kind::name != kind)
+		throw const_error("cannot modify constant value");
+
+	kind = Kind::name;
+	exact = true;
+	u.integer = value;
+	vec.reset();
+
+	return this;
+}
+
+/// Update as a defined vector variable
+SymValue* SymValue::operator=(const ArrayPtr& value) {
+	if (Kind::undefined != kind && Kind::name != kind)
+		throw const_error("cannot modify constant value");
+
+	kind = Kind::name;
+	exact = false;
+	u.value = 0.0;
+	vec = value;
 
 	return this;
 }
+
+/************************************************************************************************
+ *	SymbolTable																					*
+ ************************************************************************************************/
+
+const SymbolId SymbolTable::nBuiltins = SymbolId(nNames);
+
+/// Construct a table of just the constants, builtins and keywords
+SymbolTable::SymbolTable()
+	: ids{ 0, Index::hasher(), Index::key_equal(), Index::allocator_type(pool) },
+	  slots(std::begin(builtinValues), std::end(builtinValues)) {
+}
+
+/// Return the identifier of the constant, builtin or keyword name, or noSymbol if it isn't one
+SymbolId SymbolTable::builtin(std::string_view name) {
+	const unsigned i = builtins.slot[hash(name, builtins.seed) & (nSlots - 1)];
+	return i != 0 && builtinNames[i - 1] == name ? SymbolId(i - 1) : noSymbol;
+}
+
+/// Return name's identifier, adding an undefined symbol if required
+SymbolId SymbolTable::intern(std::string_view name) {
+	const SymbolId b = builtin(name);
+	if (b != noSymbol)
+		return b;
+
+	auto i = ids.find(name);
+	if (i != ids.end())
+		return i->second;
+
+	const SymbolId id = SymbolId(slots.size());
+	names.push_back(pool.copy(name));
+	slots.push_back(SymValue());
+	ids.emplace(names.back(), id);
+
+	return id;
+}
+
+/// Return name's identifier, or noSymbol if name isn't in the table
+SymbolId SymbolTable::find(std::string_view name) const {
+	const SymbolId b = builtin(name);
+	if (b != noSymbol)
+		return b;
+
+	auto i = ids.find(name);
+	return i == ids.end() ? noSymbol : i->second;
+}
+
+/// Return the name of symbol id
+std::string_view SymbolTable::name(SymbolId id) const {
+	return id < nBuiltins ? builtinNames[id] : names[id - nBuiltins];
+}
@@ -9,12 +9,21 @@
 #ifndef SYMBOL_H
 #define SYMBOL_H
 
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
+#include "arena.h"
+#include "array.h"
 #include "token.h"
 
+class Code;
+
 /******************************************************************************
  *	Exceptions (temp location)
  ******************************************************************************/
@@ -42,8 +51,12 @@ public:
  *	- builtin	- a function pointer that takes no parameters
  *	- builtin1 	- a function pointer that takes one parameter
  *  - builtin2	- a function pointer that takes two paramerts
+ *	- builtinv	- a function pointer that reduces a vector to a value
+ *	- function	- a user defined function; compiled Code, returning a value
+ *	- procedure	- a user defined procedure; compiled Code
+ *	- load...	- a keyword
  *
- *  And a corresponding value; double, function pointer or 'undefined'. 
+ *  And a corresponding value; double, exact integer, vector, function pointer or 'undefined'. 
  *
  *	Variables start out as undefined symbols, but become defined when their
  *  value is first set. Constant's start out defined, but attempts to modify
@@ -54,46 +67,136 @@ public:
  */
 struct SymValue {
 	Kind		kind; 					///< name, constant builtin or undefined?
+	bool		pure;					///< builtin; result depends on its arguments alone?
+	bool		exact;					///< name; is the value integer, rather than value?
 	union {
 		double	value;					///< identifier; name or constant
+		int64_t	integer;				///< name, if exact
 		double	(*func)();				///< builtin (no parameters)
 		double	(*func1)(double);		///< builtin1 (one parameters)
 		double 	(*func2)(double, double); ///< builtin2 (two parameters)
+		double	(*funcv)(const double*, size_t); ///< builtinv (vector parameter)
+		const Code* code;				///< function or procedure; its body
 	} u;								///< Symbol table value
+	ArrayPtr	vec;					///< name; if not null, a vector value
 
 	/// Default constructor results in an undefined symbol
-	SymValue() : kind (Kind::undefined) {
+	SymValue() : kind (Kind::undefined), pure(false), exact(false) {
 		u.value = 0.0;
 	}
 
 	/// Construct a defined symbol with the given kind/value
-	SymValue(double value, Kind kind = Kind::constant) : kind(kind) {
+	SymValue(double value, Kind kind = Kind::constant) : kind(kind), pure(false), exact(false) {
 		u.value = value;
 	}
 
-	/// Construct a builtin
-	SymValue(double (*func)()) : kind(Kind::builtin) {
+	/// Construct a builtin; impure unless stated otherwise, as it has no arguments
+	SymValue(double (*func)(), bool pure = false) : kind(Kind::builtin), pure(pure), exact(false) {
 		u.func = func;
 	}
 	
 	/// Construct a builtin1
-	SymValue(double (*func)(double)) : kind(Kind::builtin1) {
+	SymValue(double (*func)(double), bool pure = true) : kind(Kind::builtin1), pure(pure), exact(false) {
 		u.func1 = func;
 	}
 
 	/// Construct a builtin2
-	SymValue(double (*func)(double, double)) : kind(Kind::builtin2) {
+	SymValue(double (*func)(double, double), bool pure = true) : kind(Kind::builtin2), pure(pure), exact(false) {
 		u.func2 = func;
 	}
 
+	/// Construct a builtinv
+	SymValue(double (*func)(const double*, size_t), bool pure = true) : kind(Kind::builtinv), pure(pure), exact(false) {
+		u.funcv = func;
+	}
+
+	/// Construct a keyword
+	explicit SymValue(Kind kind) : kind(kind), pure(false), exact(false) {
+		u.value = 0.0;
+	}
+
+	/// Construct a function or procedure, with the given body
+	SymValue(Kind kind, const Code* body) : kind(kind), pure(false), exact(false) {
+		u.code = body;
+	}
+
 	/// Update and define a symbol value. Throws an const_error if not mutable
 	SymValue* operator=(double value);
 
+	/// Update and define a symbol integer value. Throws an const_error if not mutable
+	SymValue* operator=(int64_t value);
+
+	/// Update and define a symbol vector value. Throws an const_error if not mutable
+	SymValue* operator=(const ArrayPtr& value);
+
 	/// Return my double value
-	operator double() const { return u.value;	}
+	operator double() const { return exact ? double(u.integer) : u.value;	}
 };
 
-/// Alias for std::map<std::string, SymValue> 
-typedef std::map<std::string, SymValue> SymbolTable;
+/// Symbol identifier; a dense index into the SymbolTable
+typedef unsigned SymbolId;
+
+/// Identifier of no symbol at all
+const SymbolId noSymbol = ~0u;
+
+/** @brief Symbol table
+ *
+ *	Names are interned, once, into dense SymbolId's by the scanner, and values are
+ *	kept in a flat array indexed by SymbolId; the parser and virtual machine never
+ *	hash, or compare, names. Name based lookup is kept for diagnostics and
+ *	external callers.
+ *
+ *	Names, and the name to identifier index, live as long as the table, and are
+ *	allocated from a pool of their own rather than one at a time.
+ *
+ *	The constants, builtins and keywords are fixed at compile time; they have the
+ *	first nBuiltins identifiers, and are found with a perfect hash rather than
+ *	the index, which holds only the names added at run time.
+ */
+class SymbolTable {
+	/// Name to identifier, allocated from the pool
+	typedef std::unordered_map<std::string_view, SymbolId, std::hash<std::string_view>,
+		std::equal_to<std::string_view>, ArenaAllocator<std::pair<const std::string_view, SymbolId>>> Index;
+
+	Arena						pool;	///< Names, and ids' nodes
+	Index						ids;	///< Name to identifier; views of names
+	std::vector<std::string_view> names;	///< Identifier - nBuiltins to name, in pool
+	std::vector<SymValue>		slots;	///< Identifier to value
+
+public:
+	static const SymbolId		nBuiltins;	///< Number of constants, builtins and keywords
+
+	SymbolTable();
+
+	SymbolTable(const SymbolTable&) = delete;
+	SymbolTable& operator=(const SymbolTable&) = delete;
+
+	static SymbolId builtin(std::string_view name);
+
+	SymbolId intern(std::string_view name);
+	SymbolId find(std::string_view name) const;
+	std::string_view name(SymbolId id) const;
+
+	/// Return the value of symbol id
+	SymValue& operator[](SymbolId id)				{	return slots[id];		}
+
+	/// Return the value of symbol id
+	const SymValue& operator[](SymbolId id) const	{	return slots[id];		}
+
+	/// Return the value of name, adding an undefined symbol if required
+	SymValue& operator[](std::string_view name)		{	return slots[intern(name)];	}
+
+	/// Bytes allocated for names, and their index
+	size_t bytes() const							{	return pool.allocated();	}
+
+	/// Return the values, indexed by SymbolId; valid until the next intern()
+	const SymValue* data() const					{	return slots.data();	}
+
+	/// Is the table empty?
+	bool empty() const								{	return slots.empty();	}
+
+	/// Number of symbols
+	size_t size() const								{	return slots.size();	}
+};
 
 #endif
@@ -6,30 +6,62 @@
  *  Copyright (c) 2016 Randy Merkel. All rights reserved.
  */
 
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <thread>
+
 #include "token.h"
 #include "driver.h"
+#include "ring.h"
 #include "symbol.h"
 
 /************************************************************************************************
  *	Token Stream																				*
  ************************************************************************************************/
 
+/// Tokens scanned ahead on a thread of their own
+struct TokenStream::Pipeline {
+	static const size_t batch = 256;	///< Tokens scanned between publications
+
+	Ring<Token>			ring;			///< Scanned tokens, waiting to be read
+	std::atomic<bool>	cancelled;		///< Stop scanning?
+	std::thread			thread;			///< Runs TokenStream::produce()
+
+	/// Construct an empty pipeline; the thread is started separately
+	Pipeline() : ring{16 * batch}, cancelled{false} {}
+};
+
 // public:
 
+/// Initialize, reading standard input from line 1; the driver isn't yet constructed
+TokenStream::TokenStream(Driver& drv)
+	: driver{drv}, src{new ChunkedSource(0, false)}, tok{src->begin()}, p{tok}, lim{src->end()},
+	  lineStart{0}, line{1} {
+}
+
+/// Destructor
+TokenStream::~TokenStream() {
+	stop();
+}
+
 /// Read and return the next token
-Token TokenStream::get() {
+Token& TokenStream::get() {
 	if (ct.kind == Kind::none)
 		get_next();						// get the first token into nt
 	else if (nt.kind == Kind::none)
 		get_next();						// get the next token into nt
-	
+
 	ct = nt;							// next is now current...
-	
+
 	if (ct.kind == Kind::end)
 		nt = ct;						// nothing follows the end token
 	else
 		nt.kind = Kind::none;
-	
+
 	return ct;
 }
 
@@ -40,60 +72,281 @@ Token& TokenStream::next()	{
 	return nt;
 }
 
+/** Set the input to s, which the TokenStream then owns, forgetting any read-ahead
+ *
+ *	If the driver is pipelined, s is entirely in memory, and large enough, and
+ *	there's more than one CPU to share the work, a thread is started to scan it.
+ */
+void TokenStream::set_input(Source* s) {
+	stop();
+	src.reset(s);
+	tok = p = src->begin();
+	lim = src->end();
+	lineStart = 0;
+	line = driver.lineNum;
+	ct = nt = { Kind::none };
+
+	if (driver.pipelined && src->complete() && size_t(lim - p) >= pipelineMin
+			&& std::thread::hardware_concurrency() > 1) {
+		pipeline.reset(new Pipeline);
+		pipeline->thread = std::thread(&TokenStream::produce, this);
+	}
+}
+
 // private:
 
-/// Read and return the next token
-Token TokenStream::get_next() {
-	char ch = 0;
+/// Read more input, preserving the token being scanned; returns false at end of input
+bool TokenStream::refill() {
+	const ptrdiff_t n = p - tok;
+	const bool more = src->more(tok);
+
+	p = tok + n;
+	lim = src->end();
+	return more && p < lim;
+}
+
+/** Convert t, a floating-point, or integer, literal
+ *
+ *	Locale free, and correctly rounded, working directly on the input buffer.
+ *	Malformed literals, such as "1.2.3" or "1e", result in NaN, and an error.
+ *	Literals of digits alone that fit in an int64_t are exact.
+ */
+void TokenStream::number(Token& t) {
+	const char* const end = t.text.data() + t.text.size();
+	const std::from_chars_result i = std::from_chars(t.text.data(), end, t.integer_value);
+	t.exact = i.ptr == end && std::errc() == i.ec;
+	if (t.exact) {
+		t.number_value = double(t.integer_value);
+		return;
+	}
+
+	double value = 0;
+	const std::from_chars_result r = std::from_chars(t.text.data(), end, value);
+
+	if (r.ptr != end || std::errc::invalid_argument == r.ec) {
+		value = std::numeric_limits<double>::quiet_NaN();
+		t.error = "malformed number";
+
+	} else if (std::errc::result_out_of_range == r.ec)	// let strtod pick inf or 0
+		value = std::strtod(std::string(t.text).c_str(), nullptr);
+
+	t.number_value = value;
+}
+
+/// Set t to a token of kind k, with the text [tok, p)
+void TokenStream::token(Token& t, Kind k) {
+	t.kind = k;
+	t.text = std::string_view(tok, p - tok);
+	t.offset = src->offset(tok);
+	t.line = line;
+	t.column = unsigned(t.offset - lineStart + 1);
+	t.error = nullptr;
+}
+
+/// Scan tokens into the pipeline until the end of input, or stop()
+void TokenStream::produce() {
+	Ring<Token>& ring = pipeline->ring;
+	Token t { Kind::none };
+
+	for (size_t n = 1; ; ++n) {
+		scan(t);
+		while (!ring.push(t)) {
+			if (pipeline->cancelled.load(std::memory_order_relaxed))
+				return;
+			std::this_thread::yield();
+		}
+
+		if (t.kind == Kind::end || n % Pipeline::batch == 0)
+			ring.publish();
+		if (t.kind == Kind::end)
+			return;
+	}
+}
+
+/// Stop, and forget, the pipeline, if any
+void TokenStream::stop() {
+	if (!pipeline)
+		return;
+
+	pipeline->cancelled = true;
+	pipeline->thread.join();
+	pipeline.reset();
+}
+
+/** Read the next token into nt, and return it
+ *
+ *	The token is scanned, or taken from the pipeline; names are then interned,
+ *	and classified by their symbols, and lexical errors reported.
+ */
+Token& TokenStream::read() {
+	if (!pipeline)
+		scan(nt);
+	else while (!pipeline->ring.pop(nt))
+		std::this_thread::yield();
+
+	switch(nt.kind) {
+	case Kind::name: {
+		nt.sym = driver.table.intern(nt.text);
+		const SymValue& v = driver.table[nt.sym];
+		if (v.kind != Kind::undefined && v.kind != Kind::constant)
+			nt.kind = v.kind;
+		break;
+	}
+
+	case Kind::eos:
+		if (nt.text == "\n")
+			driver.lineNum = nt.line + 1;
+		break;
+
+	default:
+		break;
+	}
+
+	if (nt.error) {
+		const std::string s = nt.text.empty() ? nt.error : nt.error + (" \'" + std::string(nt.text) + '\'');
+		driver.report({ Diagnostic::Code::lexical, nt.line, nt.column, s });
+	}
+
+	return nt;
+}
+
+/// Read and return the next token, counting and timing it if the driver has stats
+Token& TokenStream::get_next() {
+	Stats* const stats = driver.stats;
+	if (!stats)
+		return read();
+
+	const uint64_t start = Stats::ticks();
+	const size_t symbols = driver.table.size();
+	read();
+	stats->lexing += Stats::ticks() - start;
+
+	++stats->tokens[static_cast<unsigned char>(nt.kind) & 127];
+	if (nt.kind != Kind::string && !nt.text.empty() && std::isalpha((unsigned char)nt.text[0]))
+		++stats->lookups;				// names are interned
+	stats->inserts += driver.table.size() - symbols;
+	return nt;
+}
+
+/** Scan the next token into t
+ *
+ *	Names are left for read() to intern. Bad tokens end the statement; they're
+ *	scanned as eos, with an error.
+ */
+void TokenStream::scan(Token& t) {
+	int ch = 0;
 
 	do {								// skip whitespace except '\n'
-		if (!ip->get(ch))
-			return nt = { Kind::end };
+		tok = p;
+		if (EOF == (ch = peek()))
+			return token(t, Kind::end);
+		++p;
 
 	} while (ch != '\n' && std::isspace(ch));
 
 	switch (ch) {
-		case '\n':
-			++driver.lineNum;
+		case '\n':						// ends the line it's on
+			token(t, Kind::eos);
+			++line;
+			lineStart = src->offset(p);
+			return;
 
 		case ';':
-			return nt = { Kind::eos };
+			return token(t, Kind::eos);
 
 		case '*':
 		case '/':
 		case '+':
 		case '-':
+		case '%':
 		case '(':
 		case ')':
-		case '=':
 		case '^':
 		case ',':
-			return nt = { static_cast<Kind>(ch) };
+		case ':':
+		case '[':
+		case ']':
+		case '{':
+		case '}':
+			return token(t, static_cast<Kind>(ch));
+
+		case '<':							// <, <=, >, >=, =, ==, ! or !=
+		case '>':
+		case '=':
+		case '!':
+			if (peek() == '=') {
+				++p;
+				return token(t, ch == '<' ? Kind::le : ch == '>' ? Kind::ge : ch == '=' ? Kind::eq : Kind::ne);
+			}
+			return token(t, static_cast<Kind>(ch));
+
+		case '&':							// && or ||
+		case '|':
+			if (peek() == ch) {
+				++p;
+				return token(t, ch == '&' ? Kind::land : Kind::lor);
+			}
+			token(t, Kind::eos);
+			t.error = "bad token";
+			return;
+
+		case '$':							// $n; function argument n
+			while (std::isdigit(peek()))
+				++p;
+			if (p - tok == 1) {
+				token(t, Kind::eos);
+				t.error = "bad token";
+				return;
+			}
+
+			token(t, Kind::arg);
+			t.number_value = std::strtod(std::string(tok + 1, p).c_str(), nullptr);
+			return;
+
+		case '"':							// string literal
+			tok = p;
+			while (EOF != (ch = peek()) && ch != '\n') {
+				if (ch == '"') {
+					token(t, Kind::string);
+					++p;					// eat '"'
+					return;
+				}
+				++p;
+			}
+
+			--tok;							// at the '"'
+			token(t, Kind::eos);
+			t.text = std::string_view(tok, 0);
+			t.error = "unterminated string";
+			return;
 
 		case '0': case '1': case '2': case '3': case '4':
 		case '5': case '6': case '7': case '8': case '9':
-		case '.':
-			ip->putback(ch);
-			*ip >> nt.number_value;
-			nt.kind = Kind::number;
-			return nt;
+		case '.':							// the longest run that could be a number
+			for (--p; std::isdigit(ch = peek()) || ch == '.'; ++p)
+				;
+
+			if (ch == 'e' || ch == 'E') {
+				++p;
+				if ((ch = peek()) == '+' || ch == '-')
+					++p;
+				while (std::isdigit(peek()))
+					++p;
+			}
+
+			token(t, Kind::number);
+			return number(t);
 
 		default:							// name, name = or error
 			if (std::isalpha(ch)) {
-				nt.string_value = ch;
-				while (ip->get(ch) && std::isalnum(ch))
-					nt.string_value += ch;
-
-				ip->putback(ch);
-				SymValue v = driver.table[nt.string_value];
-				if (v.kind == Kind::undefined || v.kind == Kind::constant)
-					nt.kind = Kind::name;	// possible undefined or constant identifier
-				else
-					nt.kind = v.kind;
-				return nt;
+				while (std::isalnum(peek()))
+					++p;
+
+				return token(t, Kind::name);
 			}
 
-			driver.error("bad token", ch);
-			return nt = { Kind::eos };
+			token(t, Kind::eos);
+			t.error = "bad token";
+			return;
 	}
 }
@@ -11,7 +11,11 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
-#include <sstream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "source.h"
 
 class Driver;
 
@@ -28,7 +32,29 @@ enum class Kind : char {
 	builtin,							///< Builtin functin with no paramers
 	builtin1,							///< Builtin function with one parameter
 	builtin2,							///< Builtin function with two parameters
+	builtinv,							///< Builtin function reducing a vector to a value
+	function,							///< User defined function; returns a value
+	procedure,							///< User defined procedure
+	load,								///< load keyword
+	while_,								///< while keyword
+	if_,								///< if keyword
+	else_,								///< else keyword
+	for_,								///< for keyword
+	func,								///< func keyword
+	proc,								///< proc keyword
+	return_,							///< return keyword
+	break_,								///< break keyword
+	continue_,							///< continue keyword
+	print,								///< print keyword
 	number,								///< floating-point literal
+	string,								///< string literal
+	arg,								///< $n; function argument n
+	le,									///< Less than or equal
+	ge,									///< Greater than or equal
+	eq,									///< Equal
+	ne,									///< Not equal
+	land,								///< Logical and
+	lor,								///< Logical or
 	end,								///< End of input
 
 	// End of non-printing character codes for ASCII and UNICODE
@@ -43,10 +69,19 @@ enum class Kind : char {
 	eos		= ';',						///< End of statement
 	assign	= '=',						///< Assignment
 
+	lt		= '<',						///< Less than
+	gt		= '>',						///< Greater than
+	lnot	= '!',						///< Logical not
+
 	comma	= ',',						///< Comma
+	colon	= ':',						///< Range seperator
 	
 	lp		= '(',						///< Opening parentheses
-	rp		= ')'						///< Closing parentheses
+	rp		= ')',						///< Closing parentheses
+	lb		= '[',						///< Opening bracket
+	rb		= ']',						///< Closing bracket
+	lbrace	= '{',						///< Opening brace
+	rbrace	= '}'						///< Closing brace
 };
 
 /************************************************************************************************
@@ -55,54 +90,76 @@ enum class Kind : char {
 
 /// A token kind/value pair
 struct Token {
-	Kind		kind;					///< Token type
-	std::string	string_value;			///< kind == name
-	double		number_value;			///< Kind == number
-
-	/// Construct a token of type k, stirng value "", number value 0.
-    Token(Kind k) : kind{k}, number_value{0} {}
+	Kind			kind;				///< Token type
+	std::string_view text;				///< Token text; for kind == string, without quotes
+	size_t			offset;				///< Offset of text from the start of input
+	unsigned		line;				///< Line number of text
+	unsigned		column;				///< Column number of text, from 1
+	unsigned		sym;				///< kind == name, builtin..., the SymbolId
+	double			number_value;		///< Kind == number, or arg
+	int64_t			integer_value;		///< Kind == number, if exact
+	bool			exact;				///< Kind == number; an integer literal, that fits in an int64_t?
+	const char*		error;				///< Lexical error, reported when the token is read, or null
+
+	/// Construct a token of type k, empty text, number value 0.
+    Token(Kind k = Kind::none) : kind{k}, offset{0}, line{0}, column{0}, sym{~0u}, number_value{0}, integer_value{0},
+		exact{false}, error{nullptr} {}
 };
 
-/// A stream of tokens... with look-ahead
+/** A stream of tokens... with look-ahead
+ *
+ *	Scans a Source in place; token text refers directly into the input buffer, and
+ *	is only valid until the next token is read.
+ *
+ *	Scanning itself doesn't depend on the driver; names are interned, and lexical
+ *	errors reported, as each token is read. So, if the driver is pipelined, large
+ *	sources that are entirely in memory are scanned ahead on a thread of their
+ *	own, with the same results, and diagnostics, in the same order.
+ */
 class TokenStream {
 public:
-	/// Initialize with an input stream which this does not own
-	TokenStream(Driver& drv, std::istream& s) : driver{drv}, ip{&s}, owns{false} {}
+	TokenStream(Driver& drv);
+	~TokenStream();
 
-	/// Initialize with an input stream which this does own
-	TokenStream(Driver& drv, std::istream* s) : driver{drv}, ip{s}, owns{true} {}
-
-	~TokenStream()						{	close();	}
-
-	Token get();
+	Token& get();
 
 	/// The current token
 	Token& current() 					{	return ct;	}
 	Token& next();						///< Next token (look-ahead)
 
-	/// Set the input stream to s
-	void set_input(std::istream& s) {
-		close();
-		ip = &s;
-		owns = false;
-	}
+	static const size_t pipelineMin = 1024 * 1024;	///< Smallest source worth pipelining
+
+	void set_input(Source* s);
 
-	/// Set the input stream to s
-	void set_input(std::istream* p) {
-		close();
-		ip = p;
-		owns = true;
-	}
+	/// Scan the n characters at s, which must outlive the input
+	void set_input(const char* s, size_t n)	{	set_input(new MemorySource(s, n));	}
 
 private:
+	struct Pipeline;
+
 	Driver&			driver;				///< The parser driver
-	std::istream*	ip;					///< Poiner to an input stream
-	bool			owns;				///< Does the TokenStream own this istream?
+	std::unique_ptr<Source>	src;		///< The input
+	const char*		tok;				///< Start of the token being scanned
+	const char*		p;					///< Next character to scan
+	const char*		lim;				///< End of the available input
+	size_t			lineStart;			///< Offset of the current line from the start of input
+	unsigned		line;				///< The line being scanned
+	std::unique_ptr<Pipeline> pipeline;	///< Scanning ahead, or null
 	Token 			ct { Kind::none };	///< Current token
 	Token 			nt { Kind::none };	///< Next token
 
-	void close()						{ if (owns) delete ip;	}
-	Token get_next();
+	bool refill();
+
+	/// Return the next character, without consuming it, or EOF at the end of input
+	int peek()							{	return p < lim || refill() ? (unsigned char)*p : EOF;	}
+
+	void number(Token& t);
+	void token(Token& t, Kind k);
+	void scan(Token& t);
+	void produce();
+	void stop();
+	Token& read();
+	Token& get_next();
 };
 
 #endif
@@ -0,0 +1,752 @@
+/** @file vm.cpp
+ *
+ *	@brief	class VM implementation
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "vm.h"
+#include "driver.h"
+#include "jit.h"
+#include "math.h"
+#include "simd.h"
+
+// private:
+
+/// Return x op y; a comparison, or logical and/or
+template<typename T>
+static bool relation(OpCode op, T x, T y) {
+	switch(op) {
+	case OpCode::lt:	return x < y;
+	case OpCode::le:	return x <= y;
+	case OpCode::gt:	return x > y;
+	case OpCode::ge:	return x >= y;
+	case OpCode::eq:	return x == y;
+	case OpCode::ne:	return x != y;
+	case OpCode::land:	return Truth(x) && Truth(y);
+	case OpCode::lor:	return Truth(x) || Truth(y);
+	default:			return 0;
+	}
+}
+
+/// Report an error, replacing v with NaN
+void VM::error(Value& v, const std::string& s) {
+	v.vec.reset();
+	v.set(driver.error(s));
+}
+
+/** Return an array for the result of an element-wise operation on left and right
+ *
+ *	Reuses either operand's array if its not shared, otherwise allocates a new one.
+ *
+ *	@param	left	Left operand
+ *	@param	right	Right operand
+ *	@param	n		Number of elements
+ *
+ *	@return	Array of n elements
+ */
+ArrayPtr VM::result(Value& left, Value& right, size_t n) {
+	if (left.vec && left.vec.use_count() == 1)
+		return left.vec;
+	else if (right.vec && right.vec.use_count() == 1)
+		return right.vec;
+	else
+		return std::make_shared<Array>(n);
+}
+
+/** Apply an arithmetic operation element by element; at least one operand is a vector
+ *
+ *	@param	op		Operation; add, sub, mul, div, mod, pow, a comparison, land or lor
+ *	@param	left	Left operand, and the result
+ *	@param	right	Right operand; popped
+ */
+void VM::elementwise(OpCode op, Value& left, Value& right) {
+	if (left.vec && right.vec && left.vec->size() != right.vec->size()) {
+		right.vec.reset();
+		return error(left, "vector length mismatch");
+	}
+
+	const Kernels& k = simd();
+	const size_t n = left.vec ? left.vec->size() : right.vec->size();
+	const double* a = left.vec ? left.vec->data() : nullptr;
+	const double* b = right.vec ? right.vec->data() : nullptr;
+	const double x = left.real(), y = right.real();
+	auto lhs = [=](size_t i) { return a ? a[i] : x; };
+	auto rhs = [=](size_t i) { return b ? b[i] : y; };
+
+	ArrayPtr r = result(left, right, n);
+	double* p = r->data();
+
+	switch(op) {
+	case OpCode::add:
+		if (a && b)			k.add(a, b, p, n);
+		else if (a)			k.adds(a, y, p, n);
+		else				k.adds(b, x, p, n);
+		break;
+
+	case OpCode::sub:
+		if (a && b)			k.sub(a, b, p, n);
+		else if (a)			k.subs(a, y, p, n);
+		else				k.rsubs(b, x, p, n);
+		break;
+
+	case OpCode::mul:
+		if (a && b)			k.mul(a, b, p, n);
+		else if (a)			k.muls(a, y, p, n);
+		else				k.muls(b, x, p, n);
+		break;
+
+	case OpCode::div:
+		if (b ? std::find(b, b + n, 0.0) != b + n : y == 0) {
+			driver.error("divide by 0");
+			for (size_t i = 0; i < n; ++i) {
+				const double d = rhs(i);
+				p[i] = d ? lhs(i) / d : std::numeric_limits<double>::quiet_NaN();
+			}
+
+		} else if (a && b)	k.div(a, b, p, n);
+		else if (a)			k.divs(a, y, p, n);
+		else				k.rdivs(b, x, p, n);
+		break;
+
+	case OpCode::mod:
+		if (b ? std::find(b, b + n, 0.0) != b + n : y == 0)
+			driver.error("divide by 0");
+		for (size_t i = 0; i < n; ++i) {
+			const double d = rhs(i);
+			p[i] = d ? std::remainder(lhs(i), d) : std::numeric_limits<double>::quiet_NaN();
+		}
+		break;
+
+	case OpCode::pow:
+		if (a && b)			Pow(a, b, p, n);
+		else if (a)			Pow(a, y, p, n);
+		else				Pow(x, b, p, n);
+		break;
+
+	default:							// comparisons and logic
+		for (size_t i = 0; i < n; ++i)
+			p[i] = relation(op, lhs(i), rhs(i));
+		break;
+	}
+
+	left.vec = r;
+	left.exact = false;
+	right.vec.reset();
+}
+
+/// Apply the builtin1 func to each element of the vector v
+void VM::elementwise(double (*func)(double), Value& v) {
+	Value none;
+	const size_t n = v.vec->size();
+	const double* a = v.vec->data();
+	ArrayPtr r = result(v, none, n);
+	double* p = r->data();
+
+	if (const Batch kernel = batch(func))
+		kernel(a, p, n);
+	else
+		for (size_t i = 0; i < n; ++i)
+			p[i] = func(a[i]);
+
+	v.vec = r;
+}
+
+/// Apply the builtin2 func element by element; at least one operand is a vector
+void VM::elementwise(double (*func)(double, double), Value& left, Value& right) {
+	if (func == static_cast<double (*)(double, double)>(Pow))
+		return elementwise(OpCode::pow, left, right);
+
+	if (left.vec && right.vec && left.vec->size() != right.vec->size()) {
+		right.vec.reset();
+		return error(left, "vector length mismatch");
+	}
+
+	const size_t n = left.vec ? left.vec->size() : right.vec->size();
+	const double* a = left.vec ? left.vec->data() : nullptr;
+	const double* b = right.vec ? right.vec->data() : nullptr;
+	const double x = left.real(), y = right.real();
+	ArrayPtr r = result(left, right, n);
+	double* p = r->data();
+
+	for (size_t i = 0; i < n; ++i)
+		p[i] = func(a ? a[i] : x, b ? b[i] : y);
+
+	left.vec = r;
+	left.exact = false;
+	right.vec.reset();
+}
+
+/** Concatenate n values into a vector
+ *
+ *	@param	first	The first value, and the result
+ *	@param	n		Number of values; first[0..n)
+ */
+void VM::concat(Value* first, unsigned n) {
+	size_t size = 0;
+	for (unsigned i = 0; i < n; ++i)
+		size += first[i].vec ? first[i].vec->size() : 1;
+
+	ArrayPtr r = std::make_shared<Array>(size);
+	double* p = r->data();
+	for (unsigned i = 0; i < n; ++i) {
+		if (first[i].vec) {
+			p = std::copy(first[i].vec->data(), first[i].vec->data() + first[i].vec->size(), p);
+			first[i].vec.reset();
+
+		} else
+			*p++ = first[i].real();
+	}
+
+	first->vec = r;
+	first->exact = false;
+}
+
+/** Build a range; [first : last : step]
+ *
+ *	@param	first	first[0] is the first value, first[1] the last and first[2] the
+ *					step. Replaced by the result.
+ */
+void VM::range(Value* first) {
+	const double from = first[0].real(), to = first[1].real(), step = first[2].real();
+	const bool numbers = !first[0].vec && !first[1].vec && !first[2].vec;
+
+	for (unsigned i = 1; i < 3; ++i)
+		first[i].vec.reset();
+
+	if (!numbers)
+		return error(*first, "range bounds must be numbers");
+	else if (!std::isfinite(from) || !std::isfinite(to) || !std::isfinite(step))
+		return error(*first, "range bounds must be finite");
+	else if (step == 0)
+		return error(*first, "range step is 0");
+
+	// Allow for rounding in the step, such that [0 : 0.3 : 0.1] includes 0.3.
+	const double count = std::floor((to - from) / step * (1 + 1e-12)) + 1;
+	if (count > 1e9)
+		return error(*first, "range too large");
+
+	const size_t n = count > 0 ? size_t(count) : 0;
+	ArrayPtr r = std::make_shared<Array>(n);
+	for (size_t i = 0; i < n; ++i)
+		(*r)[i] = from + i * step;
+
+	first->vec = r;
+	first->exact = false;
+}
+
+/// Print v
+void VM::print(const Value& v) {
+	Output& out = driver.out;
+
+	if (!v.vec) {
+		if (v.exact)
+			out << '\t' << v.integer << '\n';
+		else
+			out << '\t' << v.num << '\n';
+		return;
+	}
+
+	out << "\t[";
+	for (size_t i = 0; i < v.vec->size(); ++i) {
+		if (i)
+			out << ", ";
+		out << (*v.vec)[i];
+	}
+	out << "]\n";
+}
+
+/** Recall how often a statement, compiled anew, has been run before
+ *
+ *	Statements are compiled each time they're read, so a statement that's
+ *	repeated is counted here, by its code, rather than in its Code.
+ *
+ *	@param	code	The statement, not yet run
+ *
+ *	@return	Where to save its first expression's Code::Hot, now code.hot[0], after running it
+ */
+VM::Recent* VM::recall(const Code& code) {
+	std::string key;
+	auto put = [&key](const void* p, size_t n) { key.append(static_cast<const char*>(p), n); };
+	for (const Instr& in : code.code) {
+		put(&in.op, sizeof in.op);
+		put(&in.count, sizeof in.count);
+		put(&in.arg, sizeof in.arg);
+	}
+	put(code.consts.data(), code.consts.size() * sizeof(double));
+	put(code.ints.data(), code.ints.size() * sizeof(int64_t));
+	put(code.hosts.data(), code.hosts.size() * sizeof(double*));
+	for (const std::string& s : code.strs)
+		key += s;
+
+	if (recent.empty())
+		recent.resize(recents);
+	Recent& r = recent[std::hash<std::string>()(key) % recents];
+	if (r.key != key) {
+		r.key = std::move(key);
+		r.hot = Code::Hot();
+	}
+
+	code.hot.resize(code.code.size());
+	code.hot[0] = r.hot;
+	return &r;
+}
+
+/** Run the expression that begins at ip natively, if it's been reached often enough
+ *
+ *	An expression is compiled, once, after it has been reached Native::threshold
+ *	times; with the types its variables, and arguments, have then.
+ *
+ *	@param	code	The statement, or function body, being executed
+ *	@param	ip		The next instruction; updated past the expression, if it's run
+ *	@param	sp		The top of stack; its value is pushed, if it's run
+ *	@param	args	The arguments, $1...
+ *	@param	nargs	Number of arguments
+ *
+ *	@return	true if the expression was run natively
+ */
+bool VM::native(const Code& code, const Instr*& ip, Value*& sp, const Value* args, unsigned nargs) {
+	if (code.hot.size() != code.code.size())
+		code.hot.resize(code.code.size());
+
+	const size_t at = ip - code.code.data();
+	Code::Hot& h = code.hot[at];
+	if (!h.native) {
+		if (++h.runs != Native::threshold)
+			return false;
+
+		h.native = Native::compile(code, at, table, args, nargs, driver.memoize ? &driver.memo : nullptr);
+		if (!h.native)
+			return false;
+	}
+
+	if (!h.native->ready(table, args, nargs))
+		return false;
+
+	sp++->set((*h.native)(table, driver, args));
+	const Instr* const end = code.code.data() + h.native->end;
+	if (Stats* const stats = driver.stats) {
+		++stats->natives;				// each call in the native code was made once
+		for (; ip != end; ++ip)
+			if (ip->op == OpCode::call0 || ip->op == OpCode::call1 || ip->op == OpCode::call2)
+				stats->call(ip->arg);
+	}
+
+	ip = end;
+	return true;
+}
+
+// public:
+
+/// Construct a virtual machine for the driver d
+VM::VM(Driver& d) : driver{d}, table{d.table} {
+}
+
+/** Execute a compiled statement
+ *
+ *	Runtime errors, such as undefined variables, or division by zero, are
+ *	reported via the driver, and result in a NaN. If the driver's jit is set,
+ *	frequently run expressions may be run natively; those that begin
+ *	statements, and function bodies, loops, and the statements in them.
+ *
+ *	@param	code	The compiled statement
+ */
+void VM::operator()(const Code& code) {
+	if (stack.size() < code.temps + code.depth)
+		stack.resize(code.temps + code.depth);
+
+	Random::use(&driver.random);		// for rand() and friends
+
+	const Code* cp = &code;				// The code being executed
+	const Instr* ip = code.code.data();	// The next instruction
+	Value* tp = stack.data();			// The temporaries
+	Value* args = tp;					// The arguments, $1...
+	unsigned nargs = 0;					// Number of arguments
+	Value* sp = tp + code.temps;		// Points just past the top of stack
+	Stats* const stats = driver.stats;	// Count calls?
+	const bool jit = driver.jit;		// Run expressions natively?
+
+	if (jit && !code.code.empty()) {
+		Recent* const r = code.hot.empty() ? recall(code) : nullptr;
+		native(code, ip, sp, args, nargs);
+		if (r)
+			r->hot = code.hot[0];
+	}
+
+	for (;;) {
+		const Instr& in = *ip++;
+
+		switch(in.op) {
+		case OpCode::push:
+			sp++->set(cp->consts[in.arg]);
+			break;
+
+		case OpCode::pushi:
+			sp++->set(cp->ints[in.arg]);
+			break;
+
+		case OpCode::load: {
+			const SymValue& s = table[in.arg];
+			if (s.kind != Kind::name && s.kind != Kind::constant)
+				sp->set(driver.error("undefined variable", table.name(in.arg)));
+			else if (s.vec) {
+				sp->vec = s.vec;
+				sp->exact = false;
+			} else if (s.exact)
+				sp->set(s.u.integer);
+			else
+				sp->set(s.u.value);
+			++sp;
+			break;
+		}
+
+		case OpCode::store: {
+			SymValue& s = table[in.arg];
+			if (s.kind != Kind::name && s.kind != Kind::undefined)
+				error(sp[-1], "can not assign to " + std::string(table.name(in.arg)));
+			else if (sp[-1].vec)
+				s = sp[-1].vec;
+			else if (sp[-1].exact)
+				s = sp[-1].integer;
+			else
+				s = sp[-1].num;
+			break;
+		}
+
+		case OpCode::loadp:
+			sp++->set(*cp->hosts[in.arg]);
+			break;
+
+		case OpCode::storep:
+			if (sp[-1].vec)
+				error(sp[-1], "can not assign a vector to a host variable");
+			else
+				*cp->hosts[in.arg] = sp[-1].real();
+			break;
+
+		case OpCode::neg:
+			if (sp[-1].exact && sp[-1].integer != INT64_MIN)
+				sp[-1].integer = -sp[-1].integer;
+			else if (!sp[-1].vec)
+				sp[-1].set(-sp[-1].real());
+			else {
+				Value none;
+				ArrayPtr r = result(sp[-1], none, sp[-1].vec->size());
+				simd().neg(sp[-1].vec->data(), r->data(), r->size());
+				sp[-1].vec = r;
+			}
+			break;
+
+		case OpCode::add: {
+			--sp;
+			int64_t r;
+			if (sp[-1].exact && sp->exact && ExactAdd(sp[-1].integer, sp->integer, r))
+				sp[-1].integer = r;
+			else if (!sp[-1].vec && !sp->vec)
+				sp[-1].set(sp[-1].real() + sp->real());
+			else
+				elementwise(in.op, sp[-1], *sp);
+			break;
+		}
+
+		case OpCode::sub: {
+			--sp;
+			int64_t r;
+			if (sp[-1].exact && sp->exact && ExactSub(sp[-1].integer, sp->integer, r))
+				sp[-1].integer = r;
+			else if (!sp[-1].vec && !sp->vec)
+				sp[-1].set(sp[-1].real() - sp->real());
+			else
+				elementwise(in.op, sp[-1], *sp);
+			break;
+		}
+
+		case OpCode::mul: {
+			--sp;
+			int64_t r;
+			if (sp[-1].exact && sp->exact && ExactMul(sp[-1].integer, sp->integer, r))
+				sp[-1].integer = r;
+			else if (!sp[-1].vec && !sp->vec)
+				sp[-1].set(sp[-1].real() * sp->real());
+			else
+				elementwise(in.op, sp[-1], *sp);
+			break;
+		}
+
+		case OpCode::div: {
+			--sp;
+			int64_t r;
+			if (sp[-1].exact && sp->exact && ExactDiv(sp[-1].integer, sp->integer, r))
+				sp[-1].integer = r;
+			else if (sp[-1].vec || sp->vec)
+				elementwise(in.op, sp[-1], *sp);
+			else if (const double y = sp->real())
+				sp[-1].set(sp[-1].real() / y);
+			else
+				sp[-1].set(driver.error("divide by 0"));
+			break;
+		}
+
+		case OpCode::mod: {
+			--sp;
+			int64_t r;
+			if (sp[-1].exact && sp->exact && ExactMod(sp[-1].integer, sp->integer, r))
+				sp[-1].integer = r;
+			else if (sp[-1].vec || sp->vec)
+				elementwise(in.op, sp[-1], *sp);
+			else if (const double y = sp->real())
+				sp[-1].set(std::remainder(sp[-1].real(), y));
+			else
+				sp[-1].set(driver.error("divide by 0"));
+			break;
+		}
+
+		case OpCode::pow: {
+			--sp;
+			int64_t r;
+			if (sp[-1].exact && sp->exact && ExactPow(sp[-1].integer, sp->integer, r))
+				sp[-1].integer = r;
+			else if (!sp[-1].vec && !sp->vec)
+				sp[-1].set(Pow(sp[-1].real(), sp->real()));
+			else
+				elementwise(in.op, sp[-1], *sp);
+			break;
+		}
+
+		case OpCode::lt:
+		case OpCode::le:
+		case OpCode::gt:
+		case OpCode::ge:
+		case OpCode::eq:
+		case OpCode::ne:
+		case OpCode::land:
+		case OpCode::lor:
+			--sp;
+			if (sp[-1].exact && sp->exact)
+				sp[-1].integer = relation(in.op, sp[-1].integer, sp->integer);
+			else if (!sp[-1].vec && !sp->vec)
+				sp[-1].set(int64_t(relation(in.op, sp[-1].real(), sp->real())));
+			else
+				elementwise(in.op, sp[-1], *sp);
+			break;
+
+		case OpCode::lnot:
+			if (sp[-1].exact)
+				sp[-1].integer = !Truth(sp[-1].integer);
+			else if (!sp[-1].vec)
+				sp[-1].set(int64_t(!Truth(sp[-1].num)));
+			else {
+				Value none;
+				ArrayPtr r = result(sp[-1], none, sp[-1].vec->size());
+				const double* a = sp[-1].vec->data();
+				for (size_t i = 0; i < r->size(); ++i)
+					(*r)[i] = !Truth(a[i]);
+				sp[-1].vec = r;
+			}
+			break;
+
+		case OpCode::call0:
+			if (stats)
+				stats->call(in.arg);
+			sp++->set(table[in.arg].u.func());
+			break;
+
+		case OpCode::call1: {
+			if (stats)
+				stats->call(in.arg);
+			const SymValue& f = table[in.arg];
+			int64_t i;
+			if (sp[-1].vec)
+				elementwise(f.u.func1, sp[-1]);
+			else if (f.u.func1 == Integer) {	// exact, where it can be
+				if (!sp[-1].exact && Exact(Integer(sp[-1].num), i))
+					sp[-1].set(i);
+				else if (!sp[-1].exact)
+					sp[-1].set(Integer(sp[-1].num));
+			} else if (driver.memoize && f.pure)
+				sp[-1].set(driver.memo(in.arg, f.u.func1, sp[-1].real()));
+			else
+				sp[-1].set(f.u.func1(sp[-1].real()));
+			break;
+		}
+
+		case OpCode::call2: {
+			if (stats)
+				stats->call(in.arg);
+			const SymValue& f = table[in.arg];
+			--sp;
+			if (sp[-1].vec || sp->vec)
+				elementwise(f.u.func2, sp[-1], *sp);
+			else if (driver.memoize && f.pure)
+				sp[-1].set(driver.memo(in.arg, f.u.func2, sp[-1].real(), sp->real()));
+			else
+				sp[-1].set(f.u.func2(sp[-1].real(), sp->real()));
+			break;
+		}
+
+		case OpCode::callv: {
+			if (stats)
+				stats->call(in.arg);
+			const auto func = table[in.arg].u.funcv;
+			if (!sp[-1].vec) {
+				const double x = sp[-1].real();
+				sp[-1].set(func(&x, 1));
+			} else {
+				sp[-1].set(func(sp[-1].vec->data(), sp[-1].vec->size()));
+				sp[-1].vec.reset();
+			}
+			break;
+		}
+
+		case OpCode::call: {			// the arguments become the callee's $1...
+			if (stats)
+				stats->call(in.arg);
+			const SymValue& f = table[in.arg];
+			if (frames.size() == maxFrames) {	// abandon the statement
+				driver.error("calls nested too deeply", table.name(in.arg));
+				while (sp != stack.data())
+					(--sp)->vec.reset();
+				frames.clear();
+				return;
+			}
+
+			const Code& body = *f.u.code;
+			const size_t need = (sp - stack.data()) + body.temps + body.depth;
+			if (stack.size() < need) {	// grow, and relocate
+				Value* const base = stack.data();
+				stack.resize(std::max(need, stack.size() * 2));
+				tp = stack.data() + (tp - base);
+				args = stack.data() + (args - base);
+				sp = stack.data() + (sp - base);
+			}
+
+			frames.push_back({ cp, ip, size_t(args - stack.data()), size_t(tp - stack.data()), nargs, in.arg });
+			args = sp - in.count;
+			nargs = in.count;
+			tp = sp;
+			sp = tp + body.temps;
+			cp = &body;
+			ip = body.code.data();
+			if (jit)
+				native(body, ip, sp, args, nargs);
+			break;
+		}
+
+		case OpCode::arg:
+			if (in.arg > nargs)
+				sp->set(driver.error("missing argument", "$" + std::to_string(in.arg)));
+			else
+				*sp = args[in.arg - 1];
+			++sp;
+			break;
+
+		case OpCode::setarg:
+			if (in.arg > nargs)
+				error(sp[-1], "missing argument $" + std::to_string(in.arg));
+			else
+				args[in.arg - 1] = sp[-1];
+			break;
+
+		case OpCode::jump:
+			ip = cp->code.data() + in.arg;
+			if (jit && ip < &in)		// a loop's next iteration
+				native(*cp, ip, sp, args, nargs);
+			break;
+
+		case OpCode::jz:
+			--sp;
+			if (sp->vec) {
+				sp->vec.reset();
+				driver.error("vector condition");
+				ip = cp->code.data() + in.arg;
+
+			} else if (sp->exact ? !Truth(sp->integer) : !Truth(sp->num))
+				ip = cp->code.data() + in.arg;
+			if (jit)					// a loop's, or conditional's, body, or what follows
+				native(*cp, ip, sp, args, nargs);
+			break;
+
+		case OpCode::vector:
+			sp -= in.arg;
+			concat(sp++, in.arg);
+			break;
+
+		case OpCode::range:
+			sp -= 3;
+			range(sp++);
+			break;
+
+		case OpCode::file:
+			sp->exact = false;
+			if (!(sp->vec = Array::load(cp->strs[in.arg])))
+				sp->num = driver.error("error loading", cp->strs[in.arg]);
+			++sp;
+			break;
+
+		case OpCode::save:
+			tp[in.arg] = sp[-1];
+			break;
+
+		case OpCode::restore:
+			*sp++ = tp[in.arg];
+			break;
+
+		case OpCode::print: {			// Print and save result in "last", if it's still a variable
+			--sp;
+			SymValue& s = table[in.arg];
+			if (s.kind != Kind::name && s.kind != Kind::undefined)
+				driver.error("can not assign to " + std::string(table.name(in.arg)));
+			else if (sp->vec)
+				s = sp->vec;
+			else if (sp->exact)
+				s = sp->integer;
+			else
+				s = sp->num;
+			if (!driver.quiet)
+				print(*sp);
+			sp->vec.reset();
+			break;
+		}
+
+		case OpCode::pop:
+			(--sp)->vec.reset();
+			if (jit)					// the next statement in a block
+				native(*cp, ip, sp, args, nargs);
+			break;
+
+		case OpCode::halt:
+		case OpCode::ret: {
+			Value value;
+			if (in.op == OpCode::ret && in.arg)
+				value = std::move(*--sp);
+			else if (frames.empty()) {	// the end of the statement
+				while (sp != tp)
+					(--sp)->vec.reset();
+				return;
+
+			} else {
+				value.num = std::numeric_limits<double>::quiet_NaN();
+				if (in.op == OpCode::halt && table[frames.back().callee].kind == Kind::function)
+					value.num = driver.error("function returns no value", table.name(frames.back().callee));
+			}
+
+			while (sp != args)			// discard the operands, temporaries and arguments
+				(--sp)->vec.reset();
+			*sp++ = std::move(value);
+
+			const Frame& f = frames.back();
+			cp = f.code;
+			ip = f.ip;
+			args = stack.data() + f.args;
+			tp = stack.data() + f.temps;
+			nargs = f.count;
+			frames.pop_back();
+			break;
+		}
+		}
+	}
+}
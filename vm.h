@@ -0,0 +1,105 @@
+/** @file vm.h
+ *
+ *	@brief	class VM
+ *
+ *	The virtual machine that executes compiled statements.
+ *
+ *	Copyright (c) 2016 Randy Merkel. All rights reserved.
+ */
+
+#ifndef VM_H
+#define VM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "array.h"
+#include "code.h"
+
+class Driver;
+
+/// An evaluation stack entry; a number, an exact integer, or a vector
+struct Value {
+	union {
+		double	num = 0;				///< The value, if vec is null, and not exact
+		int64_t	integer;				///< The value, if exact
+	};
+	bool		exact = false;			///< Is the value integer? Never if vec isn't null
+	ArrayPtr	vec;					///< The value, if a vector
+
+	/// Return the value as a double
+	double real() const					{	return exact ? double(integer) : num;	}
+
+	/// Set the value to the double x
+	void set(double x)					{	num = x; exact = false;		}
+
+	/// Set the value to the exact integer i
+	void set(int64_t i)					{	integer = i; exact = true;	}
+};
+
+/** A stack based virtual machine for Code
+ *
+ *	Numbers are handled inline; vector operands are handed off to elementwise()
+ *	and friends. Stack entries above the top of stack never refer to a vector.
+ *
+ *	Integer literals, and the results of integer arithmetic, are exact int64_t's
+ *	until an operation overflows, or has a fractional result, when it's
+ *	computed as a double instead. Mixing integers and doubles results in a
+ *	double; builtins take, and return, doubles, except int(), whose result is
+ *	exact where it can be.
+ *
+ *	Functions and procedures are called without recursion; a call pushes a
+ *	Frame, and runs the body on the same stack, above its arguments. Each
+ *	frame's temporaries (shared sub-expressions) are kept on the stack, below
+ *	its operands.
+ */
+class VM {
+	/// A call's return state; the caller's
+	struct Frame {
+		const Code*		code;			///< The caller's code
+		const Instr*	ip;				///< The caller's next instruction
+		size_t			args;			///< Index, into the stack, of the caller's arguments
+		size_t			temps;			///< Index, into the stack, of the caller's temporaries
+		unsigned		count;			///< Number of caller arguments
+		SymbolId		callee;			///< The function, or procedure, called
+	};
+
+	/// A statement run recently; compiled anew each time it's read, but to the same code
+	struct Recent {
+		std::string		key;			///< The statement's code
+		Code::Hot		hot;			///< Its first expression's
+	};
+
+	/// Maximum call depth
+	static const size_t maxFrames = 100000;
+
+	/// Number of recently run statements remembered
+	static const size_t recents = 256;
+
+	Driver&				driver;			///< The driver; for error reporting
+	SymbolTable&		table;			///< The symbol table
+	std::vector<Value>	stack;			///< The evaluation stack
+	std::vector<Frame>	frames;			///< Active calls
+	std::vector<Recent>	recent;			///< Recently run statements, by hash of their code
+
+	void error(Value& v, const std::string& s);
+	ArrayPtr result(Value& left, Value& right, size_t n);
+	void elementwise(OpCode op, Value& left, Value& right);
+	void elementwise(double (*func)(double), Value& v);
+	void elementwise(double (*func)(double, double), Value& left, Value& right);
+	void concat(Value* first, unsigned n);
+	void range(Value* first);
+	void print(const Value& v);
+	Recent* recall(const Code& code);
+	bool native(const Code& code, const Instr*& ip, Value*& sp, const Value* args, unsigned nargs);
+
+public:
+	/// Construct a virtual machine for the driver d
+	VM(Driver& d);
+	virtual ~VM()	{}
+
+	void operator()(const Code& code);
+};
+
+#endif
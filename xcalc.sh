@@ -13,8 +13,8 @@ cat > expected_results1.txt <<LIMIT
 	24
 	21
 	0.5
-calc: undefined variable 'z' near line 1
-calc: divide by 0 near line 1
+calc: undefined variable 'z' near line 1, column 35
+calc: divide by 0 near line 1, column 45
 	3.14159
 	-7
 	0.666667
@@ -23,8 +23,7 @@ calc: divide by 0 near line 1
 	123.45
 	123.45
 	123.45
-calc: can not modify constant variable 'pi' near line 1
-	3
+calc: can not modify constant variable 'pi' near line 1, column 106
 	2.54103
 	2.54103
 	1
@@ -41,8 +40,8 @@ cat > expected_results2.txt <<LIMIT
 	24
 	21
 	0.5
-calc: undefined variable 'z' near line 7
-calc: divide by 0 near line 9
+calc: undefined variable 'z' near line 6, column 1
+calc: divide by 0 near line 8, column 1
 	3.14159
 	-7
 	0.666667
@@ -51,8 +50,7 @@ calc: divide by 0 near line 9
 	123.45
 	123.45
 	123.45
-calc: can not modify constant variable 'pi' near line 19
-	3
+calc: can not modify constant variable 'pi' near line 19, column 3
 	2.54103
 	2.54103
 	1
@@ -182,10 +180,750 @@ if [ "$nerrors" != "1" ]; then
 	exit
 fi
 
+#
+# Test 4 - vector values
+#
+
+echo Test "calc vectors ..."
+cat > expected_results3.txt <<LIMIT
+	[2, 4, 6, 8]
+	[1, 1.41421, 1.73205, 2]
+	[0, 0, 0, 0]
+	[0, 0.5, 1]
+	10
+	2.5
+	1
+	4
+LIMIT
+./calc "v=[1,2,3,4];v*2;sqrt(v);[1:4]-v;[0:1:0.5];sum(v);mean(v);min(v);max(v)" &> test.out
+nerrors=$?
+if [ "$nerrors" != "0" ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b 0
+	exit
+fi
+cmp test.out expected_results3.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results3.txt):"
+	diff test.out expected_results3.txt
+	exit
+fi
+
+#
+# Test 5 - output precision
+#
+
+echo Test "calc -p digits ..."
+cat > expected_results4.txt <<LIMIT
+	3.141592653589793
+	0.30000000000000004
+	[0.5, 0.3333333333333333]
+	3.1415926535897931
+	3.1
+LIMIT
+./calc -p 0 "pi;0.1+0.2;[1/2,1/3]" -p 17 "pi" -p 2 "pi" &> test.out
+nerrors=$?
+if [ "$nerrors" != "0" ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b 0
+	exit
+fi
+cmp test.out expected_results4.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results4.txt):"
+	diff test.out expected_results4.txt
+	exit
+fi
+
+#
+# Test 6 - concurrent files, each with its own variables, output in order
+#
+
+echo Test "calc -j jobs -f file ..."
+echo "x = 2; y; x * 21" > commands2.txt
+cat > expected_results5.txt <<LIMIT
+	24
+	21
+	0.5
+calc: undefined variable 'z' near line 6, column 1
+calc: divide by 0 near line 8, column 1
+	3.14159
+	-7
+	0.666667
+	6.28319
+	inf
+	123.45
+	123.45
+	123.45
+calc: can not modify constant variable 'pi' near line 19, column 3
+	2.54103
+	2.54103
+	1
+	45
+	1.5708
+calc: undefined variable 'y' near line 1, column 8
+	nan
+	42
+calc: error opening 'blif'
+calc: undefined variable 'y' near line 1, column 8
+	nan
+	42
+LIMIT
+./calc -j 2 -f commands.txt -f commands2.txt -f blif -f commands2.txt &> test.out
+nerrors=$?
+if [ "$nerrors" != "6" ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b 6
+	exit
+fi
+cmp test.out expected_results5.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results5.txt):"
+	diff test.out expected_results5.txt
+	exit
+fi
+
+#
+# Test 7 - constant folding and shared sub-expressions, each evaluated once
+#
+
+echo Test "calc optimizer ..."
+cat > expected_results6.txt <<LIMIT
+	42
+	0.0174533
+calc: divide by 0 near line 1, column 31
+	nan
+	[4, 8]
+LIMIT
+./calc "x=2; (x*3)+(x*3)^2; 2*pi/360; x/0 + x/0; [1,2]*x + [1,2]*x" &> test.out
+nerrors=$?
+if [ "$nerrors" != "1" ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b 1
+	exit
+fi
+cmp test.out expected_results6.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results6.txt):"
+	diff test.out expected_results6.txt
+	exit
+fi
+
+#
+# Test 8 - serve pipelined requests on a Unix domain socket, ending sessions with over long
+#          requests; needs perl for a client
+#
+
+if command -v perl > /dev/null; then
+	echo Test "calc --serve socket ..."
+	cat > expected_results7.txt <<LIMIT
+
+	42
+calc: undefined variable 'y' near line 2, column 9
+	nan
+
+calc: divide by 0 near line 3, column 1
+	nan
+
+calc: undefined variable 'x' near line 1, column 1
+	nan
+
+	1
+
+calc: request longer than 1048575 bytes near line 2, column 1
+
+	4
+
+LIMIT
+	./calc --serve calc.sock &
+	server=$!
+	for i in 1 2 3 4 5 6 7 8 9 10; do
+		[ -S calc.sock ] && break
+		sleep 0.1
+	done
+	perl -MIO::Socket::UNIX -e '
+		for my $reqs (["x = 2", "x * 21; y", "1/0"], ["x"]) {
+			my $s = IO::Socket::UNIX->new(Type => SOCK_STREAM, Peer => "calc.sock") or die "$!";
+			print $s map { "$_\n" } @$reqs;
+			shutdown($s, 1);
+			print while <$s>;
+		}
+		my $s = IO::Socket::UNIX->new(Type => SOCK_STREAM, Peer => "calc.sock") or die "$!";
+		print $s "1\n", "1" x (1024 * 1024);	# too long; the session ends without the client doing so
+		print while <$s>;
+		$s = IO::Socket::UNIX->new(Type => SOCK_STREAM, Peer => "calc.sock") or die "$!";
+		print $s "2 + 2\n";
+		shutdown($s, 1);
+		print while <$s>;' &> test.out
+	kill -TERM $server
+	wait $server
+	cmp test.out expected_results7.txt
+	if [ "$?" != "0" ]; then
+		echo "Test output (test.out) does not match expected (expexted_results7.txt):"
+		diff test.out expected_results7.txt
+		exit
+	fi
+	if [ -e calc.sock ]; then
+		echo "calc --serve did not remove its socket"
+		exit
+	fi
+fi
+
+#
+# Test 9 - reactive definitions, re-evaluated as the variables they read change;
+#          errors reported at the definition, conditional assignments aren't definitions, and
+#          those of called functions and procedures count
+#
+
+echo Test "calc -r ..."
+cat > expected_results8.txt <<LIMIT
+	4
+	12
+	16
+	4.41421
+calc: undefined variable 'a' near line 1, column 69
+	3
+LIMIT
+./calc -r "x = 2; y = x*2; z = sqrt(y)+x; z; x = 8; z; y; w = z + y; x = 1; w; a = a + 1; q = x; x = q + 2; q" &> test.out
+nerrors=$?
+if [ "$nerrors" != "1" ]; then
+	echo ./calc -r returned the wrong number of errors: $nerrors s/b 1
+	exit
+fi
+cmp test.out expected_results8.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results8.txt):"
+	diff test.out expected_results8.txt
+	exit
+fi
+printf 'x = 1\ny = 10 / x\nc = 1\nif (c) z = x * 10\nx = 0\ny\nz\n' > commands8.txt
+printf 'x = 3; func g() return x * 2; y = g(); x = 4; y\n' >> commands8.txt
+printf 'z = 1; w = z + 1; proc p() z = 10; p(); w\n' >> commands8.txt
+cat > expected_results8.txt <<LIMIT
+calc: divide by 0 near line 2, column 1
+	nan
+	10
+	8
+	11
+LIMIT
+./calc -r -f commands8.txt &> test.out
+nerrors=$?
+if [ "$nerrors" != "1" ]; then
+	echo ./calc -r returned the wrong number of errors: $nerrors s/b 1
+	exit
+fi
+cmp test.out expected_results8.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results8.txt):"
+	diff test.out expected_results8.txt
+	exit
+fi
+
+#
+# Test 10 - memoized builtins give the same results as calling them
+#
+
+echo Test "calc -m ..."
+cat > expected_results9.txt <<LIMIT
+	3.14159
+	3.14159
+	nan
+	nan
+	[1, 1.41421, 1.73205]
+	11.3137
+	11.3137
+	0.48
+LIMIT
+./calc -m "x = -1; 4*atan2(1, 1); 4*atan2(1, 1); log(x); log(x); sqrt([1, 2, 3]); pow(2, 3.5); 2^3.5; 0.48" > test.out 2>&1
+cmp test.out expected_results9.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results9.txt):"
+	diff test.out expected_results9.txt
+	exit
+fi
+
+#
+# Test 11 - reproducible random numbers; seeds, streams, and a stream per -j file
+#
+
+echo Test "calc seed, stream and uniform ..."
+cat > expected_results10.txt <<LIMIT
+	0.399046
+	7
+	0.954597
+	0.114177
+	7
+	0.954597
+	1
+	0.49504
+	7
+	1
+	0.49504
+	1000
+	0.399046
+	0.516679
+LIMIT
+echo "rand()" > commands10.txt
+./calc "rand(); seed(7); rand(); rand(); seed(7); rand(); stream(1); rand(); seed(7); stream(1); rand(); len(uniform([1:1000]))" > test.out 2>&1
+./calc -j 2 -f commands10.txt -f commands10.txt >> test.out 2>&1
+cmp test.out expected_results10.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results10.txt):"
+	diff test.out expected_results10.txt
+	exit
+fi
+
+#
+# Test 12 - loops, conditionals, functions and procedures; neither redefined as the other
+#
+
+echo Test "calc while, if, for, func and proc ..."
+cat > commands11.txt <<'LIMIT'
+i = 0; s = 0
+while (i < 10) { s = s + i; i = i + 1 }
+s
+if (s == 45) print 1 else print 2
+for (j = 0; j < 5; j = j + 1) {
+	if (j == 1) continue
+	if (j == 3) break
+	print j
+}
+func fact() {
+	if ($1 <= 1) return 1
+	return $1 * fact($1 - 1)
+}
+fact(10)
+proc show() print $1, $2 > $1
+show(3, 4)
+[1, 2, 3] < 2 || !1
+break
+func f() return
+func last() { return 1 }; 2
+proc last() print 1
+func twice() return $1 * 2; func g() return twice($1) + 1
+proc twice() print 99
+g(2)
+LIMIT
+cat > expected_results11.txt <<LIMIT
+	45
+	1
+	0
+	2
+	3628800
+	3
+	1
+	[1, 0, 0]
+calc: break outside of a loop near line 18, column 1
+calc: function return value expected 'f' near line 19, column 16
+calc: can not redefine 'last' near line 20, column 6
+	2
+calc: can not redefine 'last' near line 21, column 6
+calc: can not redefine 'twice' near line 23, column 6
+	5
+LIMIT
+./calc -f commands11.txt > test.out 2>&1
+nerrors=$?
+if [ $nerrors != 5 ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b 5
+	exit
+fi
+cmp test.out expected_results11.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results11.txt):"
+	diff test.out expected_results11.txt
+	exit
+fi
+
+#
+# Test 13 - statistics; counters as JSON, and calls by name
+#
+
+echo Test "calc --stats ..."
+./calc --stats=json "x = 2; sqrt(x); sqrt(x); sqrt(-1)" 2>&1 >/dev/null | sed -e 's/"time":{[^}]*},//' -e 's/,"memory":{[^}]*}//' > test.out
+cat > expected_results12.txt <<'LIMIT'
+{"statements":4,"native":0,"symbols":{"lookups":6,"inserts":1},"errors":0,"memo":{"hits":0,"misses":0},"tokens":{"name":3,"builtin1":3,"number":2,"end":1,"(":3,")":3,"-":1,"eos":3,"=":1},"calls":{"sqrt":2}}
+LIMIT
+cmp test.out expected_results12.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results12.txt):"
+	diff test.out expected_results12.txt
+	exit
+fi
+
 # 
 # Cleanup and return...
+#
+# Test 14 - error recovery; statements with errors are skipped, as are the rest of them
+#
+
+echo Test "calc error recovery ..."
+cat > commands13.txt <<'LIMIT'
+x = 1 2 3
+y = (1 + 2
+pi = 3; 4
+z = 2 & 3
+func f() { return $1 + }
+{ a = 1; b = ] }
+1 / 0
+"oops
+5
+y = 2 * $1 + 6
+@ 3
+1.2.3 + 2
+LIMIT
+cat > expected_results13.txt <<'LIMIT'
+calc: unexpected '2' near line 1, column 7
+calc: ')' expected near line 2, column 11
+calc: can not modify constant variable 'pi' near line 3, column 4
+	4
+calc: bad token '&' near line 4, column 7
+calc: primary expected near line 5, column 24
+calc: primary expected near line 6, column 14
+calc: divide by 0 near line 7, column 1
+	nan
+calc: unterminated string near line 8, column 1
+	5
+calc: argument outside of a function or procedure near line 10, column 9
+calc: bad token '@' near line 11, column 1
+calc: malformed number '1.2.3' near line 12, column 1
+{"line":4,"column":7,"code":"lexical","message":"bad token '&'"}
+{"line":6,"column":14,"code":"syntax","message":"primary expected"}
+{"line":7,"column":1,"code":"runtime","message":"divide by 0"}
+{"line":11,"column":1,"code":"lexical","message":"bad token '@'"}
+{"line":12,"column":1,"code":"lexical","message":"malformed number '1.2.3'"}
+LIMIT
+./calc -f commands13.txt > test.out 2>&1
+nerrors=$?
+if [ $nerrors != 11 ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b 11
+	exit
+fi
+./calc --errors=json -f commands13.txt 2>&1 >/dev/null | sed -n '4p;6p;7p;10p;11p' >> test.out
+cmp test.out expected_results13.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results13.txt):"
+	diff test.out expected_results13.txt
+	exit
+fi
+
+#
+# Test 15 - pipelined scanning; the same results, and diagnostics, in the same order
+#
+
+echo Test "calc --pipeline ..."
+yes "$(cat commands13.txt)" | head -n 150000 > commands14.txt
+./calc -f commands14.txt > expected_results14.txt 2>&1
+expected=$?
+./calc --pipeline -f commands14.txt > test.out 2>&1
+nerrors=$?
+if [ $nerrors != $expected ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b $expected
+	exit
+fi
+cmp test.out expected_results14.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results14.txt):"
+	diff test.out expected_results14.txt | head
+	exit
+fi
+
+#
+# Test 16 - compiled script cache; cached runs match uncached runs, and a
+#	script whose functions have changed kind, or whose entry is damaged, is parsed again
+#
+
+echo Test "calc --cache ..."
+rm -rf calc.cache
+cat commands11.txt commands13.txt > commands15.txt
+./calc -f commands15.txt > expected_results15.txt 2>&1
+expected=$?
+for run in 1 2; do
+	./calc --cache calc.cache -f commands15.txt > test.out 2>&1
+	nerrors=$?
+	if [ $nerrors != $expected ]; then
+		echo ./calc returned the wrong number of errors: $nerrors s/b $expected
+		exit
+	fi
+	cmp test.out expected_results15.txt
+	if [ "$?" != "0" ]; then
+		echo "Test output (test.out) does not match expected (expexted_results15.txt):"
+		diff test.out expected_results15.txt | head
+		exit
+	fi
+done
+./calc -e "proc fact() print 0" -f commands15.txt > expected_results15.txt 2>&1
+./calc --cache calc.cache -e "proc fact() print 0" -f commands15.txt > test.out 2>&1
+cmp test.out expected_results15.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results15.txt):"
+	diff test.out expected_results15.txt | head
+	exit
+fi
+if [ "$(ls calc.cache/*.calcc | wc -l)" != "1" ]; then
+	echo "calc --cache didn't save the compiled script"
+	exit
+fi
+
+# A damaged entry, sqrt(x) calling x rather than sqrt, is parsed again, rather than run
+printf 'x = 4\nsqrt(x)\n' > commands15.txt
+./calc -f commands15.txt > expected_results15.txt 2>&1
+./calc --cache calc.cache -f commands15.txt > /dev/null 2>&1
+entry=$(ls -t calc.cache/*.calcc | head -1)
+at=$(LC_ALL=C grep -obUaP '\x02\x00\x00[\s\S]{4}\x17\x00\x00' $entry | head -1 | cut -d: -f1)
+if [ -z "$at" ]; then
+	echo "calc --cache entry has no load x, call1 sqrt to damage"
+	exit
+fi
+dd if=$entry bs=1 skip=$((at + 3)) count=4 2>/dev/null | dd of=$entry bs=1 seek=$((at + 10)) count=4 conv=notrunc 2>/dev/null
+./calc --cache calc.cache -f commands15.txt > test.out 2>&1
+nerrors=$?
+if [ $nerrors != 0 ]; then
+	echo ./calc returned the wrong number of errors running a damaged cache entry: $nerrors s/b 0
+	exit
+fi
+cmp test.out expected_results15.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results15.txt):"
+	diff test.out expected_results15.txt | head
+	exit
+fi
+
+#
+# Test 17 - exact integers; overflow promotes to double, and int() covers 64 bits
+#
+
+echo Test "calc integers ..."
+cat > commands16.txt <<'LIMIT'
+2^62
+2^63
+2^62 + 2^62
+9223372036854775807
+9223372036854775807 + 1
+1000000 * 1000000
+int(1e15 + 0.5)
+int(2^40 * 3.5)
+int(-7.9)
+7 % 4
+6 % 4
+-7 % 4
+7 / 2
+6 / 3
+5 % 0
+n = 0; t = 0
+while (n < 100000) { n = n + 1; t = t + n * n }
+t
+x = 2^62; x * 2
+(3 > 2) + 1
+LIMIT
+cat > expected_results16.txt <<LIMIT
+	4611686018427387904
+	9.22337e+18
+	9.22337e+18
+	9223372036854775807
+	9.22337e+18
+	1000000000000
+	1000000000000000
+	3848290697216
+	-7
+	-1
+	-2
+	1
+	3.5
+	2
+calc: divide by 0 near line 15, column 1
+	nan
+	333338333350000
+	9.22337e+18
+	2
+LIMIT
+./calc -f commands16.txt > test.out 2>&1
+nerrors=$?
+if [ $nerrors != 1 ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b 1
+	exit
+fi
+cmp test.out expected_results16.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results16.txt):"
+	diff test.out expected_results16.txt
+	exit
+fi
+./calc -J -f commands16.txt 2>&1 | cmp - expected_results16.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (calc -J) does not match expected (expexted_results16.txt)"
+	exit
+fi
+
+#
+# Test 18 - libcalc; compile once, evaluate often, with host variables bound by pointer; and
+#           libcalc.so exports only Calculator
+#
+
+echo Test "calc libcalc ..."
+cat > host.cpp <<'LIMIT'
+#include <iostream>
+
+#include "libcalc.h"
+
+int main() {
+	Calculator calc;
+	double x = 0, y = 0;
+	std::cout << calc.bind("x", &x) << calc.bind("y", &y) << calc.bind("sin", &x) << '\n';
+
+	const Calculator::Expression* e = calc.compile("y = x * 2 + 1");
+	for (x = 0; x < 4; ++x)
+		std::cout << calc.evaluate(e) << ' ' << y << '\n';
+
+	calc.compile("func sq() return $1 * $1");
+	e = calc.compile("t = sq(x); x = x + 1\nt + 1");
+	for (int i = 0; i < 3; ++i)
+		std::cout << calc.evaluate(e) << ' ' << x << '\n';
+	std::cout << calc.value("t") << ' ' << calc.value("u") << '\n';
+
+	std::cout << (calc.compile("1 +\n2 + ") == nullptr) << '\n';
+	std::cout << calc.evaluate(calc.compile("1 / 0")) << '\n';
+	for (const Diagnostic& d : calc.diagnostics())
+		std::cout << Diagnostic::name(d.code) << ' ' << d.line << ':' << d.column << ' ' << d.message << '\n';
+
+	calc.jit(true);
+	e = calc.compile("x * x + y");
+	double sum = 0;
+	for (x = 0; x < 1000; ++x)
+		sum += calc.evaluate(e);
+	std::cout << sum << '\n';
+}
+LIMIT
+cat > expected_results17.txt <<'LIMIT'
+110
+1 1
+3 3
+5 5
+7 7
+17 5
+26 6
+37 7
+36 nan
+1
+nan
+syntax 1:4 primary expected
+syntax 2:5 primary expected
+runtime 1:1 divide by 0
+3.3284e+08
+LIMIT
+${CXX:-c++} -std=c++17 -pthread -I. host.cpp libcalc.a -o host
+if [ "$?" != "0" ]; then
+	echo Failed to build host.cpp against libcalc.a
+	exit
+fi
+./host > test.out 2>&1
+cmp test.out expected_results17.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results17.txt):"
+	diff test.out expected_results17.txt
+	exit
+fi
+${CXX:-c++} -std=c++17 -pthread -I. host.cpp -L. -lcalc -Wl,-rpath,. -o host
+if [ "$?" != "0" ]; then
+	echo Failed to build host.cpp against libcalc.so
+	exit
+fi
+./host 2>&1 | cmp - expected_results17.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (host, with libcalc.so) does not match expected (expexted_results17.txt)"
+	exit
+fi
+if command -v nm > /dev/null; then
+	exports=$(nm -DC --defined-only libcalc.so | grep -v ' Calculator::')
+	if [ -n "$exports" ]; then
+		echo "libcalc.so exports more than Calculator:"
+		echo "$exports" | head
+		exit
+	fi
+fi
+
+#
+# Test 19 - --csv; columns bound by name, one result column per expression, in order on any
+# number of threads
+#
+
+echo Test "calc --csv ..."
+printf 'a,b,"c d",name\r\n1,2,3,x\r\n4,5,6,"y, ""q"""\r\n\r\n"7",+8,9,"multi\nline"\n10\n  11 , 1e1 ,,\nfoo,3\n' > commands18.txt
+cat > expected_results18.txt <<'LIMIT'
+a + b,b / (a - 4),a * 2
+3,-0.6666666666666666,2
+calc: divide by 0 near line 3, column 2
+9,nan,8
+15,2.6666666666666665,14
+nan,nan,20
+21,1.4285714285714286,22
+nan,nan,nan
+LIMIT
+./calc -p 0 --csv 'a + b' 'b / (a - 4)' 'a * 2' commands18.txt > test.out 2>&1
+nerrors=$?
+if [ $nerrors != 1 ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b 1
+	exit
+fi
+cmp test.out expected_results18.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (test.out) does not match expected (expexted_results18.txt):"
+	diff test.out expected_results18.txt
+	exit
+fi
+./calc -p 0 --csv 'a + b' 'b / (a - 4)' 'a * 2' - < commands18.txt 2>&1 | cmp - expected_results18.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (calc --csv expr... -) does not match expected (expexted_results18.txt)"
+	exit
+fi
+awk 'BEGIN { print "n,v,s"; for (i = 0; i < 400000; ++i) printf "%d,%d.25,\"s\n%d\"\n", i, i % 97, i }' > commands19.txt
+./calc -j 1 --csv 'n * v' 'n % 7' commands19.txt > expected_results19.txt 2>&1
+./calc -j 4 --csv 'n * v' 'n % 7' commands19.txt 2>&1 | cmp - expected_results19.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (calc -j 4 --csv) does not match -j 1 (expexted_results19.txt)"
+	exit
+fi
+if [ "$(wc -l < expected_results19.txt)" != "400001" ]; then
+	echo "calc --csv wrote the wrong number of rows"
+	exit
+fi
+./calc --csv 'a +' commands18.txt > test.out 2>&1
+nerrors=$?
+if [ $nerrors != 1 ]; then
+	echo ./calc returned the wrong number of errors: $nerrors s/b 1
+	exit
+fi
+
+#
+# Test 20 - -J; hot loops, function bodies and repeated statements run natively, with the same results
+#
+
+echo Test "calc -J ..."
+cat > commands20.txt <<'LIMIT'
+s = 0
+for (i = 0; i < 100000; i = i + 1) s = s + sqrt(i)
+s
+func f() return $1 * 2.5 + 1
+t = 0
+i = 0
+while (i < 1000) { t = t + f(i); i = i + 1 }
+t
+x = 1
+for (i = 0; i < 100; i = i + 1) x = x * 1.5
+x
+LIMIT
+for i in 1 2 3 4 5 6 7 8 9 10 11 12; do echo "y = 3.5; sqrt(y) * 2 + 1"; done >> commands20.txt
+./calc -f commands20.txt > expected_results20.txt 2>&1
+./calc -J --stats=json -f commands20.txt 2>stats.out | cmp - expected_results20.txt
+if [ "$?" != "0" ]; then
+	echo "Test output (calc -J) does not match calc (expexted_results20.txt)"
+	exit
+fi
+native=$(sed -n -e 's/.*"native":\([0-9]*\).*/\1/p' stats.out)
+if [ "$(uname -m)" = "x86_64" ] && [ "$native" -lt 100000 ]; then
+	echo "calc -J ran $native expressions natively, s/b at least 100000"
+	exit
+fi
+
 #
 
-rm -f test.out commands.txt expected_results*.txt
+rm -rf calc.cache
+rm -f test.out stats.out commands*.txt expected_results*.txt
+rm -f host host.cpp
 
 echo All tests passed!